@@ -0,0 +1,122 @@
+// Time of BVH frustum and ray queries at 1k to 1M items, next to a scan of every box. The world
+// grows with the item count so its density stays the same: a query sees about as many items at
+// every size, and its cost should grow with the depth of the tree rather than with the count.
+// The best of 5 runs of 100 frustums and 1000 rays each, and the time of build().
+
+#include <rg/BVH.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+static double since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    const unsigned int runs = 5;
+    const unsigned int frustumCount = 100;
+    const unsigned int rayCount = 1000;
+    for (unsigned int count : {1000u, 10000u, 100000u, 1000000u}) {
+        // 1000 items in a 100 m cube, scaled up
+        float half = 50.0f * std::cbrt(count / 1000.0f);
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> position(-half, half);
+        std::uniform_real_distribution<float> size(0.5f, 2.0f);
+        std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+        std::vector<unsigned int> items(count);
+        std::vector<AABB> boxes(count);
+        for (unsigned int i = 0; i < count; ++i) {
+            items[i] = i;
+            boxes[i].min = glm::vec3(position(random), position(random), position(random));
+            boxes[i].max = boxes[i].min + glm::vec3(size(random), size(random), size(random));
+        }
+        std::vector<Frustum> frustums;
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 30.0f);
+        for (unsigned int i = 0; i < frustumCount; ++i) {
+            glm::vec3 eye(position(random), position(random), position(random));
+            glm::vec3 direction(component(random), component(random), component(random));
+            frustums.push_back(Frustum::fromMatrix(projection * glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f))));
+        }
+        std::vector<glm::vec3> origins, directions;
+        for (unsigned int i = 0; i < rayCount; ++i) {
+            origins.emplace_back(position(random), position(random), position(random));
+            directions.emplace_back(component(random), component(random), component(random));
+        }
+
+        BVH bvh;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bvh.build(items, boxes);
+        double build = since(start);
+
+        std::vector<unsigned int> found;
+        double query = 1e30, scan = 1e30;
+        std::size_t visible = 0;
+        for (unsigned int run = 0; run < runs; ++run) {
+            visible = 0;
+            start = std::chrono::steady_clock::now();
+            for (const Frustum &frustum : frustums) {
+                found.clear();
+                bvh.queryFrustum(frustum, found);
+                visible += found.size();
+            }
+            query = std::min(query, since(start));
+            start = std::chrono::steady_clock::now();
+            std::size_t scanned = 0;
+            for (const Frustum &frustum : frustums) {
+                for (const AABB &box : boxes) {
+                    scanned += testFrustum(frustum, box) != OUTSIDE_FRUSTUM;
+                }
+            }
+            scan = std::min(scan, since(start));
+            if (scanned != visible) {
+                std::cout << "frustum query and scan disagree" << std::endl;
+                return 1;
+            }
+        }
+
+        double raycast = 1e30, rayScan = 1e30;
+        unsigned int hits = 0;
+        for (unsigned int run = 0; run < runs; ++run) {
+            hits = 0;
+            start = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < rayCount; ++i) {
+                unsigned int item;
+                float distance;
+                hits += bvh.raycast(origins[i], directions[i], item, distance);
+            }
+            raycast = std::min(raycast, since(start));
+            start = std::chrono::steady_clock::now();
+            unsigned int scanHits = 0;
+            for (unsigned int i = 0; i < rayCount; ++i) {
+                glm::vec3 inverseDirection = glm::vec3(1.0f) / directions[i];
+                float best = std::numeric_limits<float>::max();
+                bool hit = false;
+                for (const AABB &box : boxes) {
+                    float distance;
+                    if (box.intersectsRay(origins[i], inverseDirection, best, distance)) {
+                        best = distance;
+                        hit = true;
+                    }
+                }
+                scanHits += hit;
+            }
+            rayScan = std::min(rayScan, since(start));
+            if (scanHits != hits) {
+                std::cout << "raycast and scan disagree" << std::endl;
+                return 1;
+            }
+        }
+
+        std::cout << count << " items: build " << build / 1000.0 << " ms, frustum "
+                  << query / frustumCount << " us (" << visible / frustumCount << " visible, scan "
+                  << scan / frustumCount << " us), ray " << raycast / rayCount << " us (" << hits << " of "
+                  << rayCount << " hit, scan " << rayScan / rayCount << " us)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+// Time of one FrustumCuller::cull() over 100k random spheres with each kernel the benchmark was
+// compiled with, the best of 200 runs. tests/frustum_test.cpp checks that the kernels agree.
+
+#include <rg/Frustum.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+int main() {
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.0f, 12.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::fromMatrix(projection * view);
+
+    const unsigned int count = 100000;
+    const unsigned int runs = 200;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+    FrustumCuller culler;
+    culler.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        culler.add(glm::vec3(position(random), position(random), position(random)), size(random));
+    }
+
+    std::vector<CullKernel> kernels = {CullKernel::Scalar};
+    if (FrustumCuller::widestKernel() != CullKernel::Scalar) {
+        kernels.push_back(CullKernel::SSE);
+    }
+    if (FrustumCuller::widestKernel() == CullKernel::AVX) {
+        kernels.push_back(CullKernel::AVX);
+    }
+    const char *names[] = {"scalar", "SSE", "AVX"};
+    for (CullKernel kernel : kernels) {
+        double best = 1e30;
+        for (unsigned int run = 0; run < runs; ++run) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            culler.cull(frustum, kernel);
+            best = std::min(best, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::cout << names[(int) kernel] << ": " << best << " us per " << count << " spheres, "
+                  << culler.visibleCount() << " visible" << std::endl;
+    }
+    return 0;
+}
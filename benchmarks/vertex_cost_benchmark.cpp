@@ -0,0 +1,226 @@
+// Vertex shader cost of object.vs against the version before the normal matrix and the
+// view-projection were precomputed on the CPU, which did transpose(inverse(aModel)) and
+// projection * view for every vertex. A 100x100 grid drawn with 1000 instances (10M vertex
+// invocations) into a 1x1 viewport, so next to nothing is rasterized. Prints the best wall time
+// of 10 draws (glFinish around each) and the GpuTimer average, over 6 rounds.
+// Needs a GL 3.3 context: run it from the repository root, or pass the path of object.vs.
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <rg/GpuTimer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char *oldVertexShader = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aModel;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+void main()
+{
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(aModel))) * aNormal;
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
+)";
+
+// uses every output so none of the vertex work is optimized away
+static const char *fragmentShader = R"(#version 330 core
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(FragPos + Normal, TexCoords.x);
+}
+)";
+
+static unsigned int compile(GLenum type, const std::string &source) {
+    unsigned int shader = glCreateShader(type);
+    const char *text = source.c_str();
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[1024];
+        glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
+        std::cout << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+    return shader;
+}
+
+static unsigned int link(const std::string &vertexSource) {
+    unsigned int vertex = compile(GL_VERTEX_SHADER, vertexSource);
+    unsigned int fragment = compile(GL_FRAGMENT_SHADER, fragmentShader);
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[1024];
+        glGetProgramInfoLog(program, sizeof(infoLog), nullptr, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Camera"), 0);
+    return program;
+}
+
+int main(int argc, char **argv) {
+    std::string objectPath = argc > 1 ? argv[1] : "resources/shaders/object.vs";
+    std::ifstream file(objectPath);
+    if (!file) {
+        std::cout << "can't read " << objectPath << std::endl;
+        return 1;
+    }
+    std::stringstream objectSource;
+    objectSource << file.rdbuf();
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "vertex_cost_benchmark", nullptr, nullptr);
+    if (window == nullptr) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return 1;
+    }
+    std::cout << glGetString(GL_RENDERER) << std::endl;
+
+    unsigned int programs[2] = {link(oldVertexShader), link(objectSource.str())};
+    const char *names[2] = {"per-vertex inverse", "precomputed      "};
+
+    const unsigned int side = 100;
+    const unsigned int instances = 1000;
+    std::vector<float> vertices;
+    for (unsigned int y = 0; y < side; ++y) {
+        for (unsigned int x = 0; x < side; ++x) {
+            float vertex[8] = {x * 0.01f, y * 0.01f, 0.0f, 0.0f, 0.0f, 1.0f, (float) x / side, (float) y / side};
+            vertices.insert(vertices.end(), vertex, vertex + 8);
+        }
+    }
+    std::vector<unsigned int> indices;
+    for (unsigned int y = 0; y + 1 < side; ++y) {
+        for (unsigned int x = 0; x + 1 < side; ++x) {
+            unsigned int a = y * side + x;
+            unsigned int quad[6] = {a, a + 1, a + side, a + 1, a + side + 1, a + side};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    // the InstanceBuffer layout: a mat4 model matrix, then the normal matrix as three vec4 columns
+    std::vector<float> instanceData;
+    for (unsigned int i = 0; i < instances; ++i) {
+        float model[16] = {1.2f, 0.1f, 0.0f, 0.0f, -0.1f, 1.1f, 0.0f, 0.0f, 0.0f, 0.0f, 0.9f, 0.0f, i * 0.001f, 0.0f, -5.0f, 1.0f};
+        float normal[12] = {0.8f, 0.07f, 0.0f, 0.0f, -0.07f, 0.9f, 0.0f, 0.0f, 0.0f, 0.0f, 1.1f, 0.0f};
+        instanceData.insert(instanceData.end(), model, model + 16);
+        instanceData.insert(instanceData.end(), normal, normal + 12);
+    }
+    const GLsizei instanceStride = 28 * sizeof(float);
+
+    unsigned int VAO, VBO, EBO, instanceVBO, cameraUBO;
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    for (unsigned int attribute = 0; attribute < 3; ++attribute) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribPointer(attribute, attribute == 2 ? 2 : 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
+                              (void *) (attribute * 3 * sizeof(float)));
+    }
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(float), instanceData.data(), GL_STATIC_DRAW);
+    for (unsigned int column = 0; column < 4; ++column) {
+        glEnableVertexAttribArray(5 + column);
+        glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, instanceStride, (void *) (column * 4 * sizeof(float)));
+        glVertexAttribDivisor(5 + column, 1);
+    }
+    for (unsigned int column = 0; column < 3; ++column) {
+        glEnableVertexAttribArray(12 + column);
+        glVertexAttribPointer(12 + column, 3, GL_FLOAT, GL_FALSE, instanceStride, (void *) ((16 + column * 4) * sizeof(float)));
+        glVertexAttribDivisor(12 + column, 1);
+    }
+    // Camera block: projection, view, viewPos, viewProjection, all identity
+    float camera[52] = {};
+    for (unsigned int i = 0; i < 4; ++i) {
+        camera[i * 5] = 1.0f;
+        camera[16 + i * 5] = 1.0f;
+        camera[36 + i * 5] = 1.0f;
+    }
+    glGenBuffers(1, &cameraUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(camera), camera, GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, cameraUBO);
+    glViewport(0, 0, 1, 1);
+
+    const unsigned int rounds = 6;
+    const unsigned int runs = 10;
+    for (unsigned int round = 0; round < rounds; ++round) {
+        for (unsigned int p = 0; p < 2; ++p) {
+            glUseProgram(programs[p]);
+            GpuTimer timer;
+            double wall = 1e30;
+            // GpuTimer reads a query GPU_TIMER_FRAMES draws later, the extra draws collect the last ones
+            for (unsigned int run = 0; run < runs + GPU_TIMER_FRAMES; ++run) {
+                glFinish();
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                timer.begin();
+                glDrawElementsInstanced(GL_TRIANGLES, (GLsizei) indices.size(), GL_UNSIGNED_INT, 0, instances);
+                timer.end();
+                glFinish();
+                if (run < runs) {
+                    wall = std::min(wall, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                }
+            }
+            std::cout << names[p] << ": " << wall << " ms wall, " << timer.milliseconds() << " ms GPU ("
+                      << timer.samples() << " samples) for " << side * side * instances / 1000000.0
+                      << "M vertex invocations" << std::endl;
+        }
+    }
+
+    glDeleteProgram(programs[0]);
+    glDeleteProgram(programs[1]);
+    glDeleteBuffers(1, &cameraUBO);
+    glDeleteBuffers(1, &instanceVBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteVertexArrays(1, &VAO);
+    glfwTerminate();
+    return 0;
+}
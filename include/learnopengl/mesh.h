@@ -7,9 +7,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/Material.h>
+#include <rg/GLState.h>
 
 #include <string>
 #include <vector>
+#include <algorithm>
 using namespace std;
 
 struct Vertex {
@@ -27,73 +30,83 @@ struct Vertex {
 
 
 
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
-};
-
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
-    vector<Texture>      textures;
+    unsigned int         material; // index into the owning model's materials
+    // bounds in model space
+    glm::vec3            aabbMin;
+    glm::vec3            aabbMax;
+    glm::vec3            sphereCenter;
+    float                sphereRadius;
 
     unsigned int VAO;
-    std::string glslIdentifierPrefix;
+    VertexArrayHandle vertexArray; // VAO as draw items refer to it
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, unsigned int material)
     {
         this->vertices = vertices;
         this->indices = indices;
-        this->textures = textures;
+        this->material = material;
+
+        computeBounds();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
-    // render the mesh
-    void Draw(Shader &shader)
+    // render the mesh, the material's textures have to be bound already
+    void Draw()
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-
-        // draw mesh
-        glBindVertexArray(VAO);
+        GLState::current().bindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // points attributes 0-4 of the bound VAO at Vertex data in the bound GL_ARRAY_BUFFER
+    static void setVertexAttributes()
+    {
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        // vertex tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        // vertex bitangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
     }
 
 private:
     // render data
     unsigned int VBO, EBO;
 
+    // the sphere is centered on the box, its radius reaches the farthest vertex
+    void computeBounds()
+    {
+        aabbMin = glm::vec3(0.0f);
+        aabbMax = glm::vec3(0.0f);
+        sphereCenter = glm::vec3(0.0f);
+        sphereRadius = 0.0f;
+        if (vertices.empty())
+            return;
+        aabbMin = aabbMax = vertices[0].Position;
+        for (const Vertex &vertex : vertices)
+        {
+            aabbMin = glm::min(aabbMin, vertex.Position);
+            aabbMax = glm::max(aabbMax, vertex.Position);
+        }
+        sphereCenter = (aabbMin + aabbMax) * 0.5f;
+        for (const Vertex &vertex : vertices)
+            sphereRadius = std::max(sphereRadius, glm::length(vertex.Position - sphereCenter));
+    }
+
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
@@ -101,8 +114,11 @@ private:
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
+        VertexArrayInfo info;
+        info.count = indices.size();
+        vertexArray = Resources::current().vertexArrays().add(VAO, info);
 
-        glBindVertexArray(VAO);
+        GLState::current().bindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
@@ -113,24 +129,7 @@ private:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        setVertexAttributes();
     }
 };
 #endif
\ No newline at end of file
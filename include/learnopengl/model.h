@@ -12,6 +12,11 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/InstanceBuffer.h>
+#include <rg/RenderQueue.h>
+#include <rg/MultiDrawBatch.h>
+#include <rg/BVH.h>
+#include <rg/SoftwareOcclusion.h>
 
 #include <string>
 #include <fstream>
@@ -22,6 +27,7 @@
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+TextureHandle LoadTexture(const char *path, const string &directory);
 
 
 
@@ -29,8 +35,10 @@ class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<unsigned int> texturePaths;	// interned file names of the model's textures, each once, in load order
     vector<Mesh>    meshes;
+    vector<Material> materials;   // one per scene material that is actually used, meshes refer to them by index
+    vector<OccluderMesh> occluders; // meshes named "occluder..." in the file, used for occlusion culling and never drawn
     string directory;
     bool gammaCorrection;
 
@@ -40,19 +48,95 @@ public:
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
+    // model space box around every mesh
+    AABB Bounds() const
+    {
+        AABB bounds;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            bounds.extend(meshes[i].aabbMin);
+            bounds.extend(meshes[i].aabbMax);
+        }
+        return bounds;
+    }
+
+    // draws the model, and thus all its meshes. The shader's samplers must have been
+    // pointed at the material units once with Material::setSamplers.
     void Draw(Shader &shader)
     {
+        unsigned int bound = materials.size();
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        {
+            bindMaterial(meshes[i].material, bound);
+            meshes[i].Draw();
+        }
     }
 
-    void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+    // queues one instanced draw per mesh instead of drawing right away. The instance data is
+    // uploaded now, so the transforms only have to live until this call returns, and each call's
+    // draws keep their own instances when the model is submitted more than once a frame.
+    // With an occlusion query the draws are conditioned on it, see DrawItem::occlusionQuery.
+    void Submit(RenderQueue &queue, RenderPass pass, const Shader &shader, const glm::mat4 *transforms,
+                unsigned int count, unsigned int occlusionQuery = 0)
+    {
+        if (count == 0)
+            return;
+        StreamRange range = instances.upload(transforms, count);
+        // order by the first instance, instanced copies are drawn together anyway
+        glm::vec3 position = glm::vec3(transforms[0][3]);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const Mesh &mesh = meshes[i];
+            DrawItem item;
+            item.program = shader.handle;
+            item.vao = mesh.vertexArray;
+            for(unsigned int type = 0; type < TEXTURE_TYPE_COUNT; type++)
+                item.textures[type] = materials[mesh.material].texture((TextureType) type);
+            item.count = mesh.indices.size();
+            item.instanceCount = count;
+            item.indexed = true;
+            item.occlusionQuery = occlusionQuery;
+            item.instances = range;
+            queue.submit(pass, item, position);
         }
     }
+
+    // copies every mesh and material into the batch, needed once before Submit(batch, ...)
+    void AddTo(MultiDrawBatch &batch)
+    {
+        batchMeshes.clear();
+        batchMaterials.clear();
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            batchMeshes.push_back(batch.addMesh(meshes[i]));
+        for(unsigned int i = 0; i < materials.size(); i++)
+            batchMaterials.push_back(batch.addMaterial(materials[i]));
+    }
+
+    // adds one indirect command per mesh, all of them reading the same count transforms
+    void Submit(MultiDrawBatch &batch, const glm::mat4 *transforms, unsigned int count, const unsigned int *lights = nullptr)
+    {
+        if (count == 0)
+            return;
+        unsigned int firstTransform = batch.addTransforms(transforms, count, lights);
+        for(unsigned int i = 0; i < batchMeshes.size(); i++)
+            batch.add(batchMeshes[i], batchMaterials[meshes[i].material], firstTransform, count);
+    }
+
 private:
+    InstanceBuffer instances;
+    vector<unsigned int> batchMeshes;    // mesh ids in the batch the model was added to
+    vector<unsigned int> batchMaterials; // material ids in that batch
+    map<unsigned int, unsigned int> sceneMaterials; // scene material index -> index in materials, only used while loading
+
+    // binds the material unless it is the one bound by the previous mesh
+    void bindMaterial(unsigned int material, unsigned int &bound)
+    {
+        if (material == bound)
+            return;
+        materials[material].bind();
+        bound = material;
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
@@ -81,6 +165,11 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+            if (string(mesh->mName.C_Str()).find("occluder") != string::npos)
+            {
+                occluders.push_back(processOccluder(mesh));
+                continue;
+            }
             meshes.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
@@ -91,12 +180,26 @@ private:
 
     }
 
+    // keeps only the positions and triangles of a mesh flagged as an occluder
+    OccluderMesh processOccluder(aiMesh *mesh)
+    {
+        OccluderMesh occluder;
+        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+            occluder.positions.push_back(glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z));
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            aiFace face = mesh->mFaces[i];
+            if (face.mNumIndices == 3)
+                occluder.indices.insert(occluder.indices.end(), face.mIndices, face.mIndices + 3);
+        }
+        return occluder;
+    }
+
     Mesh processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
-        vector<Texture> textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -151,68 +254,52 @@ private:
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-        aiColor3D color(0.0f, 0.0f, 0.0f);
-        material->Get(AI_MATKEY_COLOR_AMBIENT, color);
-
+        // return a mesh object created from the extracted mesh data
+        return Mesh(vertices, indices, loadMaterial(scene, mesh->mMaterialIndex));
+    }
 
+    // builds the Material of a scene material the first time a mesh uses it and returns its index
+    unsigned int loadMaterial(const aiScene *scene, unsigned int sceneIndex)
+    {
+        map<unsigned int, unsigned int>::iterator it = sceneMaterials.find(sceneIndex);
+        if (it != sceneMaterials.end())
+            return it->second;
+
+        aiMaterial* material = scene->mMaterials[sceneIndex];
+        // each texture type has its own unit, see TextureType. Shaders name the samplers after
+        // the type, e.g. 'material.diffuse' or 'texture_diffuse1', and set them with Material::setSamplers.
+        Material result;
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(result, material, aiTextureType_DIFFUSE, TEXTURE_DIFFUSE);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(result, material, aiTextureType_SPECULAR, TEXTURE_SPECULAR);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(result, material, aiTextureType_HEIGHT, TEXTURE_NORMAL);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        loadMaterialTextures(result, material, aiTextureType_AMBIENT, TEXTURE_HEIGHT);
+        // without a specular map the diffuse map doubles as one, which is what the object
+        // shader sampled before its samplers were set
+        if (result.texture(TEXTURE_SPECULAR).isNull())
+            result.setTexture(TEXTURE_SPECULAR, result.texture(TEXTURE_DIFFUSE));
+
+        materials.push_back(result);
+        sceneMaterials[sceneIndex] = materials.size() - 1;
+        return materials.size() - 1;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // assigns the material's textures of a given type to its slot for typeName. LoadTexture only
+    // loads files no model has loaded before.
+    void loadMaterialTextures(Material &result, aiMaterial *mat, aiTextureType type, TextureType typeName)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            result.setTexture(typeName, LoadTexture(str.C_Str(), this->directory));
+            unsigned int path = Resources::current().strings().intern(str.C_Str());
+            if (std::find(texturePaths.begin(), texturePaths.end(), path) == texturePaths.end())
+                texturePaths.push_back(path);
         }
-        return textures;
     }
 };
 
@@ -237,7 +324,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::current().bindTexture(0, GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -256,4 +343,14 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 
     return textureID;
 }
+
+// loads a texture file once, later calls for the same file get the same handle as long as it is alive
+TextureHandle LoadTexture(const char *path, const string &directory)
+{
+    string filename = directory + '/' + string(path);
+    TextureHandle texture = Resources::current().findTexture(filename);
+    if (texture.isNull())
+        texture = Resources::current().addTexture(TextureFromFile(path, directory), filename);
+    return texture;
+}
 #endif
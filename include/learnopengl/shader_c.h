@@ -0,0 +1,165 @@
+#ifndef COMPUTE_SHADER_H
+#define COMPUTE_SHADER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GLState.h>
+#include <rg/GLFeatures.h> // GL_COMPUTE_SHADER and glDispatchCompute, glad only covers GL 3.3
+#include <rg/ProgramCache.h>
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+// a program with a single compute stage, only usable when GLFeatures::computeShader is set
+class ComputeShader
+{
+public:
+    unsigned int ID;
+    // constructor generates the shader on the fly, or loads it from the ProgramCache
+    // ------------------------------------------------------------------------
+    ComputeShader(const char* computePath)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        // 1. retrieve the compute shader source code from filePath
+        std::string computeCode;
+        std::ifstream cShaderFile;
+        // ensure ifstream objects can throw exceptions:
+        cShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            cShaderFile.open(computePath);
+            std::stringstream cShaderStream;
+            cShaderStream << cShaderFile.rdbuf();
+            cShaderFile.close();
+            computeCode = cShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
+        // 2. the binary cached for this source and this driver, if there is one
+        ProgramCache &cache = ProgramCache::current();
+        std::string cacheName(computePath);
+        uint64_t cacheKey = cache.key({&computeCode});
+        ID = glCreateProgram();
+        bool compiled = !cache.load(ID, cacheName, cacheKey);
+        if (compiled)
+        {
+            // 3. compile shader
+            const char* cShaderCode = computeCode.c_str();
+            unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+            glShaderSource(compute, 1, &cShaderCode, NULL);
+            glCompileShader(compute);
+            // shader Program
+            glAttachShader(ID, compute);
+            cache.prepare(ID);
+            glLinkProgram(ID);
+            checkCompileErrors(compute, "COMPUTE");
+            if (checkCompileErrors(ID, "PROGRAM"))
+                cache.save(ID, cacheName, cacheKey);
+            glDetachShader(ID, compute);
+            glDeleteShader(compute);
+        }
+        ProgramCache::activeUniforms(ID, uniformLocations);
+        cache.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                     compiled);
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use() const
+    {
+        GLState::current().useProgram(ID);
+    }
+    // runs the program over groupsX * groupsY * groupsZ work groups, the program must be in use
+    // ------------------------------------------------------------------------
+    void dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1) const
+    {
+        GLFeatures::current().dispatchCompute(groupsX, groupsY, groupsZ);
+    }
+    // returns the location of an active uniform, resolved once at link time (-1 if it is not active).
+    // ------------------------------------------------------------------------
+    int getUniformLocation(const std::string &name) const
+    {
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // utility uniform functions, per-frame callers should resolve the location once and pass it
+    // ------------------------------------------------------------------------
+    void setBool(const std::string &name, bool value) const
+    {
+        setBool(getUniformLocation(name), value);
+    }
+    void setBool(int location, bool value) const
+    {
+        glUniform1i(location, (int)value);
+    }
+    void setInt(const std::string &name, int value) const
+    {
+        setInt(getUniformLocation(name), value);
+    }
+    void setInt(int location, int value) const
+    {
+        glUniform1i(location, value);
+    }
+    void setVec2(const std::string &name, const glm::vec2 &value) const
+    {
+        setVec2(getUniformLocation(name), value);
+    }
+    void setVec2(int location, const glm::vec2 &value) const
+    {
+        glUniform2fv(location, 1, &value[0]);
+    }
+    void setVec4Array(const std::string &name, const glm::vec4 *values, int count) const
+    {
+        setVec4Array(getUniformLocation(name), values, count);
+    }
+    void setVec4Array(int location, const glm::vec4 *values, int count) const
+    {
+        glUniform4fv(location, count, &values[0][0]);
+    }
+    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    {
+        setMat4(getUniformLocation(name), mat);
+    }
+    void setMat4(int location, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+private:
+    std::unordered_map<std::string, int> uniformLocations;
+
+    // utility function for checking shader compilation/linking errors.
+    // ------------------------------------------------------------------------
+    // returns true without errors
+    bool checkCompileErrors(GLuint shader, std::string type)
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if (type != "PROGRAM")
+        {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success)
+            {
+                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        else
+        {
+            glGetProgramiv(shader, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        return success != 0;
+    }
+};
+#endif
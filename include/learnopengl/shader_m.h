@@ -3,8 +3,14 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <rg/GLState.h>
+#include <rg/ProgramCache.h>
+#include <rg/Resources.h>
 
+#include <chrono>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -13,10 +19,14 @@ class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    ProgramHandle handle; // the program as draw items refer to it
+    // constructor generates the shader on the fly, or loads it from the ProgramCache when it was
+    // built from the same sources before. defines are "#define NAME value" lines compiled into
+    // both stages, see ShaderVariants.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string &defines = "")
     {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
         vertexPath = vertexPathString.c_str();
@@ -43,107 +53,207 @@ public:
             vShaderFile.close();
             fShaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            vertexCode = insertDefines(vShaderStream.str(), defines);
+            fragmentCode = insertDefines(fShaderStream.str(), defines);
         }
         catch (std::ifstream::failure& e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // shader Program
+        // 2. the binary cached for these exact sources and this driver, if there is one
+        ProgramCache &cache = ProgramCache::current();
+        std::string cacheName = vertexPathString + "\n" + fragmentPathString + "\n" + defines;
+        uint64_t cacheKey = cache.key({&vertexCode, &fragmentCode});
         ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-
+        bool compiled = !cache.load(ID, cacheName, cacheKey);
+        if (compiled)
+        {
+            // 3. compile shaders. Their status is only asked for after linking, so the driver
+            // doesn't have to finish each compile before the next one is issued
+            const char* vShaderCode = vertexCode.c_str();
+            const char * fShaderCode = fragmentCode.c_str();
+            unsigned int vertex, fragment;
+            // vertex shader
+            vertex = glCreateShader(GL_VERTEX_SHADER);
+            glShaderSource(vertex, 1, &vShaderCode, NULL);
+            glCompileShader(vertex);
+            // fragment Shader
+            fragment = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(fragment, 1, &fShaderCode, NULL);
+            glCompileShader(fragment);
+            // shader Program
+            glAttachShader(ID, vertex);
+            glAttachShader(ID, fragment);
+            cache.prepare(ID);
+            glLinkProgram(ID);
+            checkCompileErrors(vertex, "VERTEX");
+            checkCompileErrors(fragment, "FRAGMENT");
+            if (checkCompileErrors(ID, "PROGRAM"))
+                cache.save(ID, cacheName, cacheKey);
+            // delete the shaders as they're linked into our program now and no longer necessery
+            glDetachShader(ID, vertex);
+            glDetachShader(ID, fragment);
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+        }
+        ProgramInfo info;
+        info.vertexPath = Resources::current().strings().intern(vertexPathString);
+        info.fragmentPath = Resources::current().strings().intern(fragmentPathString);
+        info.defines = Resources::current().strings().intern(defines);
+        handle = Resources::current().programs().add(ID, info);
+        ProgramCache::activeUniforms(ID, uniformLocations);
+        cache.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                     compiled);
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() const
     { 
-        glUseProgram(ID); 
+        GLState::current().useProgram(ID);
+    }
+    // returns the location of an active uniform, resolved once at link time (-1 if it is not active).
+    // hot paths should look the location up once and use the location overloads below.
+    // ------------------------------------------------------------------------
+    int getUniformLocation(const std::string &name) const
+    {
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // connects a uniform block of this program to one of the shared binding points.
+    // blocks the program doesn't use are ignored.
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &blockName, unsigned int binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, blockName.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        setBool(getUniformLocation(name), value);
+    }
+    void setBool(int location, bool value) const
+    {
+        glUniform1i(location, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        setInt(getUniformLocation(name), value);
+    }
+    void setInt(int location, int value) const
+    {
+        glUniform1i(location, value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        setFloat(getUniformLocation(name), value);
+    }
+    void setFloat(int location, float value) const
+    {
+        glUniform1f(location, value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec2(getUniformLocation(name), value);
+    }
+    void setVec2(int location, const glm::vec2 &value) const
+    {
+        glUniform2fv(location, 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        setVec2(getUniformLocation(name), x, y);
+    }
+    void setVec2(int location, float x, float y) const
+    {
+        glUniform2f(location, x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec3(getUniformLocation(name), value);
+    }
+    void setVec3(int location, const glm::vec3 &value) const
+    {
+        glUniform3fv(location, 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        setVec3(getUniformLocation(name), x, y, z);
+    }
+    void setVec3(int location, float x, float y, float z) const
+    {
+        glUniform3f(location, x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec4(getUniformLocation(name), value);
+    }
+    void setVec4(int location, const glm::vec4 &value) const
+    {
+        glUniform4fv(location, 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        setVec4(getUniformLocation(name), x, y, z, w);
+    }
+    void setVec4(int location, float x, float y, float z, float w) const
+    {
+        glUniform4f(location, x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(getUniformLocation(name), mat);
+    }
+    void setMat2(int location, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(getUniformLocation(name), mat);
+    }
+    void setMat3(int location, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(getUniformLocation(name), mat);
+    }
+    void setMat4(int location, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
-    // utility function for checking shader compilation/linking errors.
+    std::unordered_map<std::string, int> uniformLocations;
+    // puts the defines right after the #version line, which has to stay first. #line keeps the
+    // line numbers of compile errors those of the file.
+    // ------------------------------------------------------------------------
+    static std::string insertDefines(const std::string &code, const std::string &defines)
+    {
+        if (defines.empty())
+            return code;
+        std::string::size_type version = code.find("#version");
+        std::string::size_type lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return defines + code;
+        return code.substr(0, lineEnd + 1) + defines + "#line 2\n" + code.substr(lineEnd + 1);
+    }
+
+    // utility function for checking shader compilation/linking errors, returns true without any.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -165,6 +275,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
@@ -0,0 +1,323 @@
+#ifndef PROJECT_BASE_BVH_H
+#define PROJECT_BASE_BVH_H
+
+#include <glm/glm.hpp>
+#include <rg/Frustum.h>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstddef>
+
+struct AABB {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void extend(const glm::vec3 &point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void extend(const AABB &box) {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    bool contains(const glm::vec3 &point) const {
+        return point.x >= min.x && point.y >= min.y && point.z >= min.z &&
+               point.x <= max.x && point.y <= max.y && point.z <= max.z;
+    }
+
+    glm::vec3 center() const {
+        return (min + max) * 0.5f;
+    }
+
+    float surfaceArea() const {
+        glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    // box around the transformed box, from the transformed corners
+    AABB transformed(const glm::mat4 &transform) const {
+        AABB result;
+        for (int corner = 0; corner < 8; ++corner) {
+            glm::vec3 point((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z);
+            result.extend(glm::vec3(transform * glm::vec4(point, 1.0f)));
+        }
+        return result;
+    }
+
+    // slab test, on a hit distance is where the ray enters the box (0 if it starts inside)
+    bool intersectsRay(const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance,
+                       float &distance) const {
+        glm::vec3 t0 = (min - origin) * inverseDirection;
+        glm::vec3 t1 = (max - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+        float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        distance = enter;
+        return enter <= exit;
+    }
+};
+
+enum FrustumTest {
+    OUTSIDE_FRUSTUM,
+    INTERSECTS_FRUSTUM,
+    INSIDE_FRUSTUM
+};
+
+// the corner farthest along a plane's normal decides if the box is outside, the nearest if it is inside
+inline FrustumTest testFrustum(const Frustum &frustum, const AABB &box) {
+    FrustumTest result = INSIDE_FRUSTUM;
+    for (const glm::vec4 &plane : frustum.planes) {
+        glm::vec3 farthest(plane.x > 0 ? box.max.x : box.min.x, plane.y > 0 ? box.max.y : box.min.y,
+                           plane.z > 0 ? box.max.z : box.min.z);
+        if (glm::dot(glm::vec3(plane), farthest) + plane.w < 0) {
+            return OUTSIDE_FRUSTUM;
+        }
+        glm::vec3 nearest(plane.x > 0 ? box.min.x : box.max.x, plane.y > 0 ? box.min.y : box.max.y,
+                          plane.z > 0 ? box.min.z : box.max.z);
+        if (glm::dot(glm::vec3(plane), nearest) + plane.w < 0) {
+            result = INTERSECTS_FRUSTUM;
+        }
+    }
+    return result;
+}
+
+// Bounding volume hierarchy with one item per leaf. build() splits top-down with a binned
+// surface area heuristic; afterwards refit() moves single items and only touches the
+// path to the root, which keeps animated items cheap at the cost of slowly looser boxes.
+// Frustum and ray queries only descend into the nodes they touch, so for items that are spread
+// out they cost far less than a scan and grow much slower than the item count (see bvh_benchmark).
+class BVH {
+public:
+    // item ids are small integers chosen by the caller (e.g. scene node indices)
+    void build(const std::vector<unsigned int> &items, const std::vector<AABB> &boxes) {
+        m_Nodes.clear();
+        m_LeafOfItem.clear();
+        if (items.empty()) {
+            return;
+        }
+        std::vector<BuildItem> buildItems(items.size());
+        unsigned int maxItem = 0;
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            buildItems[i] = {items[i], boxes[i], boxes[i].center()};
+            maxItem = std::max(maxItem, items[i]);
+        }
+        m_LeafOfItem.assign(maxItem + 1, NONE);
+        m_Nodes.reserve(2 * items.size() - 1);
+        buildNode(buildItems, 0, buildItems.size(), NONE);
+    }
+
+    bool contains(unsigned int item) const {
+        return item < m_LeafOfItem.size() && m_LeafOfItem[item] != NONE;
+    }
+
+    // gives an item a new box and grows or shrinks every ancestor to fit
+    void refit(unsigned int item, const AABB &box) {
+        unsigned int node = m_LeafOfItem[item];
+        m_Nodes[node].box = box;
+        for (node = m_Nodes[node].parent; node != NONE; node = m_Nodes[node].parent) {
+            Node &parent = m_Nodes[node];
+            parent.box = m_Nodes[parent.left].box;
+            parent.box.extend(m_Nodes[parent.right].box);
+        }
+    }
+
+    // appends every item whose box is at least partly inside the frustum
+    void queryFrustum(const Frustum &frustum, std::vector<unsigned int> &items) const {
+        if (m_Nodes.empty()) {
+            return;
+        }
+        m_Stack.clear();
+        m_Stack.push_back(0);
+        while (!m_Stack.empty()) {
+            unsigned int index = m_Stack.back();
+            m_Stack.pop_back();
+            FrustumTest test = testFrustum(frustum, m_Nodes[index].box);
+            if (test == OUTSIDE_FRUSTUM) {
+                continue;
+            }
+            if (test == INSIDE_FRUSTUM) {
+                collect(index, items);
+                continue;
+            }
+            const Node &node = m_Nodes[index];
+            if (node.item != NONE) {
+                items.push_back(node.item);
+            } else {
+                m_Stack.push_back(node.left);
+                m_Stack.push_back(node.right);
+            }
+        }
+    }
+
+    // nearest item whose box the ray hits, direction does not need to be normalized
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, unsigned int &item, float &distance) const {
+        if (m_Nodes.empty()) {
+            return false;
+        }
+        glm::vec3 inverseDirection = glm::vec3(1.0f) / direction;
+        float best = std::numeric_limits<float>::max();
+        bool hit = false;
+        float entry;
+        if (!m_Nodes[0].box.intersectsRay(origin, inverseDirection, best, entry)) {
+            return false;
+        }
+        m_Stack.clear();
+        m_Stack.push_back(0);
+        while (!m_Stack.empty()) {
+            const Node &node = m_Nodes[m_Stack.back()];
+            m_Stack.pop_back();
+            if (!node.box.intersectsRay(origin, inverseDirection, best, entry)) {
+                continue;
+            }
+            if (node.item != NONE) {
+                best = entry;
+                item = node.item;
+                hit = true;
+                continue;
+            }
+            // visit the nearer child first so the farther one is more likely to be pruned by best
+            float leftEntry, rightEntry;
+            bool left = m_Nodes[node.left].box.intersectsRay(origin, inverseDirection, best, leftEntry);
+            bool right = m_Nodes[node.right].box.intersectsRay(origin, inverseDirection, best, rightEntry);
+            if (left && right) {
+                bool leftFirst = leftEntry <= rightEntry;
+                m_Stack.push_back(leftFirst ? node.right : node.left);
+                m_Stack.push_back(leftFirst ? node.left : node.right);
+            } else if (left) {
+                m_Stack.push_back(node.left);
+            } else if (right) {
+                m_Stack.push_back(node.right);
+            }
+        }
+        distance = best;
+        return hit;
+    }
+
+    std::size_t nodeCount() const {
+        return m_Nodes.size();
+    }
+
+    // surface area of the box around everything, grows as refits loosen the tree
+    float rootArea() const {
+        return m_Nodes.empty() ? 0.0f : m_Nodes[0].box.surfaceArea();
+    }
+
+private:
+    static const unsigned int NONE = ~0u;
+    static const int BIN_COUNT = 12;
+
+    struct Node {
+        AABB box;
+        unsigned int parent;
+        unsigned int left;
+        unsigned int right;
+        unsigned int item; // NONE for inner nodes
+    };
+
+    struct BuildItem {
+        unsigned int item;
+        AABB box;
+        glm::vec3 center;
+    };
+
+    std::vector<Node> m_Nodes;
+    std::vector<unsigned int> m_LeafOfItem;
+    mutable std::vector<unsigned int> m_Stack;
+
+    unsigned int buildNode(std::vector<BuildItem> &items, std::size_t first, std::size_t last, unsigned int parent) {
+        unsigned int index = m_Nodes.size();
+        m_Nodes.push_back({AABB(), parent, NONE, NONE, NONE});
+        AABB box, centers;
+        for (std::size_t i = first; i < last; ++i) {
+            box.extend(items[i].box);
+            centers.extend(items[i].center);
+        }
+        m_Nodes[index].box = box;
+
+        if (last - first == 1) {
+            m_Nodes[index].item = items[first].item;
+            m_LeafOfItem[items[first].item] = index;
+            return index;
+        }
+
+        std::size_t middle = split(items, first, last, centers);
+        unsigned int left = buildNode(items, first, middle, index);
+        unsigned int right = buildNode(items, middle, last, index);
+        m_Nodes[index].left = left;
+        m_Nodes[index].right = right;
+        return index;
+    }
+
+    // binned SAH along the widest centroid axis, falls back to a median split when all centers coincide
+    std::size_t split(std::vector<BuildItem> &items, std::size_t first, std::size_t last, const AABB &centers) {
+        glm::vec3 extent = centers.max - centers.min;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        float low = centers.min[axis];
+        float width = extent[axis];
+        std::size_t middle = first + (last - first) / 2;
+        if (width <= 0.0f) {
+            return middle;
+        }
+
+        AABB binBoxes[BIN_COUNT];
+        std::size_t binCounts[BIN_COUNT] = {0};
+        float scale = BIN_COUNT / width;
+        for (std::size_t i = first; i < last; ++i) {
+            int bin = std::min(BIN_COUNT - 1, (int) ((items[i].center[axis] - low) * scale));
+            binBoxes[bin].extend(items[i].box);
+            ++binCounts[bin];
+        }
+        // cost of splitting after bin i: area * count on each side, swept from both ends
+        float leftCost[BIN_COUNT - 1];
+        AABB sweep;
+        std::size_t count = 0;
+        for (int i = 0; i < BIN_COUNT - 1; ++i) {
+            sweep.extend(binBoxes[i]);
+            count += binCounts[i];
+            leftCost[i] = count ? sweep.surfaceArea() * count : 0.0f;
+        }
+        sweep = AABB();
+        count = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        int bestSplit = -1;
+        for (int i = BIN_COUNT - 1; i > 0; --i) {
+            sweep.extend(binBoxes[i]);
+            count += binCounts[i];
+            float cost = leftCost[i - 1] + (count ? sweep.surfaceArea() * count : 0.0f);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = i;
+            }
+        }
+
+        BuildItem *begin = items.data() + first;
+        BuildItem *end = items.data() + last;
+        BuildItem *partition = std::partition(begin, end, [&](const BuildItem &item) {
+            return std::min(BIN_COUNT - 1, (int) ((item.center[axis] - low) * scale)) < bestSplit;
+        });
+        if (partition == begin || partition == end) {
+            return middle;
+        }
+        return first + (partition - begin);
+    }
+
+    void collect(unsigned int index, std::vector<unsigned int> &items) const {
+        std::size_t base = m_Stack.size();
+        m_Stack.push_back(index);
+        while (m_Stack.size() > base) {
+            const Node &node = m_Nodes[m_Stack.back()];
+            m_Stack.pop_back();
+            if (node.item != NONE) {
+                items.push_back(node.item);
+            } else {
+                m_Stack.push_back(node.left);
+                m_Stack.push_back(node.right);
+            }
+        }
+    }
+};
+
+#endif //PROJECT_BASE_BVH_H
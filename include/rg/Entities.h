@@ -0,0 +1,205 @@
+#ifndef PROJECT_BASE_ENTITIES_H
+#define PROJECT_BASE_ENTITIES_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+typedef unsigned int Entity;
+const Entity NO_ENTITY = ~0u;
+const unsigned int NO_SLOT = ~0u;
+
+// Sparse set of one component type. The components sit packed in one array and their
+// entities in a parallel one, so iterating a pool is a linear walk over slots 0..size();
+// a sparse array indexed by entity finds an entity's slot. remove() moves the last
+// component into the hole, so slots change on removal and after sort().
+template <typename T>
+class ComponentPool {
+public:
+    T &add(Entity entity, const T &component) {
+        if (entity >= m_Sparse.size()) {
+            m_Sparse.resize(entity + 1, NO_SLOT);
+        }
+        if (m_Sparse[entity] != NO_SLOT) {
+            return m_Components[m_Sparse[entity]] = component;
+        }
+        m_Sparse[entity] = m_Entities.size();
+        m_Entities.push_back(entity);
+        m_Components.push_back(component);
+        return m_Components.back();
+    }
+
+    void remove(Entity entity) {
+        if (!has(entity)) {
+            return;
+        }
+        unsigned int slot = m_Sparse[entity];
+        Entity last = m_Entities.back();
+        m_Entities[slot] = last;
+        m_Components[slot] = std::move(m_Components.back());
+        m_Sparse[last] = slot;
+        m_Entities.pop_back();
+        m_Components.pop_back();
+        m_Sparse[entity] = NO_SLOT;
+    }
+
+    bool has(Entity entity) const {
+        return entity < m_Sparse.size() && m_Sparse[entity] != NO_SLOT;
+    }
+
+    T &get(Entity entity) {
+        return m_Components[m_Sparse[entity]];
+    }
+
+    const T &get(Entity entity) const {
+        return m_Components[m_Sparse[entity]];
+    }
+
+    std::size_t size() const {
+        return m_Components.size();
+    }
+
+    Entity entity(std::size_t slot) const {
+        return m_Entities[slot];
+    }
+
+    T &component(std::size_t slot) {
+        return m_Components[slot];
+    }
+
+    const T &component(std::size_t slot) const {
+        return m_Components[slot];
+    }
+
+    // reorders the slots so iteration visits components in the given order, equal ones keep theirs
+    template <typename Less>
+    void sort(Less less) {
+        std::vector<unsigned int> order(size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+            return less(m_Components[a], m_Components[b]);
+        });
+        reorder(order);
+    }
+
+    // puts the entities the other pool has first and in its order, so walking both pools
+    // side by side reads both arrays front to back
+    template <typename U>
+    void sortLike(const ComponentPool<U> &other) {
+        std::vector<unsigned int> order;
+        order.reserve(size());
+        for (std::size_t slot = 0; slot < other.size(); ++slot) {
+            if (has(other.entity(slot))) {
+                order.push_back(m_Sparse[other.entity(slot)]);
+            }
+        }
+        for (std::size_t slot = 0; slot < size(); ++slot) {
+            if (!other.has(m_Entities[slot])) {
+                order.push_back(slot);
+            }
+        }
+        reorder(order);
+    }
+
+private:
+    std::vector<unsigned int> m_Sparse; // slot of every entity, NO_SLOT without the component
+    std::vector<Entity> m_Entities;
+    std::vector<T> m_Components;
+
+    // slot i gets what was in slot order[i]
+    void reorder(const std::vector<unsigned int> &order) {
+        std::vector<Entity> entities(size());
+        std::vector<T> components;
+        components.reserve(size());
+        for (unsigned int slot = 0; slot < order.size(); ++slot) {
+            entities[slot] = m_Entities[order[slot]];
+            components.push_back(std::move(m_Components[order[slot]]));
+            m_Sparse[entities[slot]] = slot;
+        }
+        m_Entities.swap(entities);
+        m_Components.swap(components);
+    }
+};
+
+// the node of the SceneGraph that holds the entity's local and world matrix and its bounds
+struct Transform {
+    unsigned int node;
+};
+
+const unsigned int NO_OCCLUSION = ~0u;
+
+// something to draw: which of the application's drawables, and the OcclusionQueries
+// object that decides whether it is hidden, if any
+struct Renderable {
+    unsigned int drawable;
+    unsigned int occlusion = NO_OCCLUSION;
+};
+
+// a point light at an offset in the space of the entity's node
+struct PointLight {
+    glm::vec3 offset;
+    float linear;
+    float quadratic;
+};
+
+// The objects of the scene as entities with components, each kind in its own ComponentPool.
+// Destroyed entities are reused by later create() calls.
+class Entities {
+public:
+    Entity create() {
+        if (!m_Free.empty()) {
+            Entity entity = m_Free.back();
+            m_Free.pop_back();
+            return entity;
+        }
+        return m_Count++;
+    }
+
+    void destroy(Entity entity) {
+        m_Transforms.remove(entity);
+        m_Renderables.remove(entity);
+        m_PointLights.remove(entity);
+        m_Free.push_back(entity);
+    }
+
+    // entities alive
+    std::size_t size() const {
+        return m_Count - m_Free.size();
+    }
+
+    ComponentPool<Transform> &transforms() {
+        return m_Transforms;
+    }
+
+    const ComponentPool<Transform> &transforms() const {
+        return m_Transforms;
+    }
+
+    ComponentPool<Renderable> &renderables() {
+        return m_Renderables;
+    }
+
+    const ComponentPool<Renderable> &renderables() const {
+        return m_Renderables;
+    }
+
+    ComponentPool<PointLight> &pointLights() {
+        return m_PointLights;
+    }
+
+    const ComponentPool<PointLight> &pointLights() const {
+        return m_PointLights;
+    }
+
+private:
+    Entity m_Count = 0;
+    std::vector<Entity> m_Free;
+    ComponentPool<Transform> m_Transforms;
+    ComponentPool<Renderable> m_Renderables;
+    ComponentPool<PointLight> m_PointLights;
+};
+
+#endif //PROJECT_BASE_ENTITIES_H
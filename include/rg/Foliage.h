@@ -0,0 +1,84 @@
+#ifndef PROJECT_BASE_FOLIAGE_H
+#define PROJECT_BASE_FOLIAGE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GLState.h>
+#include <rg/RenderQueue.h>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// A tuft of grass: ringCount rings stacked ringHeight apart, each made of bladeCount
+// textured quads spread evenly around the vertical axis through position.
+struct FoliageClump {
+    glm::vec3 position;
+    float ringHeight;
+    unsigned int ringCount;
+    unsigned int bladeCount;
+};
+
+// Draws any number of clumps with a single instanced draw. Blades are generated in
+// vegetationShader.vs from gl_VertexID (blade and corner) and gl_InstanceID (clump),
+// so the only vertex data is one FoliageClump per instance.
+class FoliageRenderer {
+public:
+    void setClumps(const std::vector<FoliageClump> &clumps) {
+        if (m_VAO == 0) {
+            setup();
+        }
+        m_ClumpCount = 0;
+        m_MaxBlades = 0;
+        std::vector<FoliageClump> visible;
+        visible.reserve(clumps.size());
+        for (const FoliageClump &clump : clumps) {
+            if (clump.ringCount == 0 || clump.bladeCount == 0) {
+                continue;
+            }
+            visible.push_back(clump);
+            m_MaxBlades = std::max(m_MaxBlades, clump.ringCount * clump.bladeCount);
+        }
+        m_ClumpCount = visible.size();
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        glBufferData(GL_ARRAY_BUFFER, visible.size() * sizeof(FoliageClump), visible.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // geometry part of a queued draw, the caller fills in program and textures. Clumps with
+    // fewer blades than the largest one emit degenerate triangles for the rest.
+    DrawItem drawItem() const {
+        DrawItem item;
+        item.vao = m_VertexArray;
+        item.count = 6 * m_MaxBlades;
+        item.instanceCount = m_ClumpCount;
+        item.ownDepth = true; // alpha tested
+        return item;
+    }
+
+private:
+    unsigned int m_VAO = 0;
+    unsigned int m_VBO = 0;
+    VertexArrayHandle m_VertexArray;
+    std::size_t m_ClumpCount = 0;
+    unsigned int m_MaxBlades = 0;
+
+    void setup() {
+        glGenVertexArrays(1, &m_VAO);
+        glGenBuffers(1, &m_VBO);
+        m_VertexArray = Resources::current().vertexArrays().add(m_VAO);
+        GLState::current().bindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        // position + ring height
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(FoliageClump), (void *) offsetof(FoliageClump, position));
+        glVertexAttribDivisor(0, 1);
+        // ring count + blades per ring
+        glEnableVertexAttribArray(1);
+        glVertexAttribIPointer(1, 2, GL_UNSIGNED_INT, sizeof(FoliageClump), (void *) offsetof(FoliageClump, ringCount));
+        glVertexAttribDivisor(1, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif //PROJECT_BASE_FOLIAGE_H
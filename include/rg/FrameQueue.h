@@ -0,0 +1,146 @@
+#ifndef PROJECT_BASE_FRAMEQUEUE_H
+#define PROJECT_BASE_FRAMEQUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+// where the time of the frames since the last resetTimings() went, in milliseconds per frame
+struct FrameTimings {
+    unsigned int frames = 0;
+    double producer = 0.0; // building a packet, without waiting for room in the queue
+    double consumer = 0.0; // consuming one, without waiting for the next
+    double frame = 0.0;    // between two packets taken by the consumer
+
+    // time both threads were busy at once
+    double overlap() const {
+        return producer + consumer > frame ? producer + consumer - frame : 0.0;
+    }
+};
+
+inline std::ostream &operator<<(std::ostream &out, const FrameTimings &timings) {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2) << "simulation " << timings.producer << " ms, render "
+        << timings.consumer << " ms, frame " << timings.frame << " ms, " << timings.overlap() << " ms overlapped";
+    out.flags(flags);
+    out.precision(precision);
+    return out;
+}
+
+// Bounded queue of frame packets between a producer thread that builds them and a consumer
+// thread that draws them. With a depth of n the producer can be up to n packets ahead, so
+// frame N + 1 is built while frame N is drawn; a full queue blocks the producer and an empty
+// one the consumer. Packets are moved in and out, the consumer owns what it pops.
+template <typename T>
+class FrameQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FrameQueue(std::size_t depth)
+            : m_Depth(depth > 0 ? depth : 1) {
+    }
+
+    FrameQueue(const FrameQueue&) = delete;
+    FrameQueue& operator=(const FrameQueue&) = delete;
+
+    std::size_t depth() const {
+        return m_Depth;
+    }
+
+    // producerTime is how long the packet took to build, it shows up in timings().
+    // Returns false once the queue is closed, the packet is dropped then.
+    bool push(T &&packet, double producerTime) {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_NotFull.wait(lock, [this] { return m_Closed || m_Packets.size() < m_Depth; });
+        if (m_Closed) {
+            return false;
+        }
+        m_Packets.push_back(std::move(packet));
+        m_Sum.producer += producerTime;
+        ++m_Sum.produced;
+        m_NotEmpty.notify_one();
+        return true;
+    }
+
+    // takes the oldest packet, returns false once the queue is closed and drained
+    bool pop(T &packet) {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_NotEmpty.wait(lock, [this] { return m_Closed || !m_Packets.empty(); });
+        if (m_Packets.empty()) {
+            return false;
+        }
+        packet = std::move(m_Packets.front());
+        m_Packets.pop_front();
+        Clock::time_point now = Clock::now();
+        if (m_Popped) {
+            m_Sum.frame += milliseconds(m_LastPop, now);
+            ++m_Sum.frames;
+        }
+        m_LastPop = now;
+        m_Popped = true;
+        m_NotFull.notify_one();
+        return true;
+    }
+
+    // how long the consumer worked on the packet it popped last
+    void finished(double consumerTime) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Sum.consumer += consumerTime;
+        ++m_Sum.consumed;
+    }
+
+    // wakes both sides, push() and pop() fail from then on once nothing is left
+    void close() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Closed = true;
+        m_NotFull.notify_all();
+        m_NotEmpty.notify_all();
+    }
+
+    // averages over the frames since the last resetTimings()
+    FrameTimings timings() const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        FrameTimings average;
+        average.frames = m_Sum.frames;
+        average.producer = m_Sum.produced ? m_Sum.producer / m_Sum.produced : 0.0;
+        average.consumer = m_Sum.consumed ? m_Sum.consumer / m_Sum.consumed : 0.0;
+        average.frame = m_Sum.frames ? m_Sum.frame / m_Sum.frames : 0.0;
+        return average;
+    }
+
+    void resetTimings() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Sum = Sums();
+    }
+
+    static double milliseconds(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+private:
+    struct Sums {
+        double producer = 0.0;
+        double consumer = 0.0;
+        double frame = 0.0;
+        unsigned int produced = 0;
+        unsigned int consumed = 0;
+        unsigned int frames = 0;
+    };
+
+    std::size_t m_Depth;
+    std::deque<T> m_Packets;
+    bool m_Closed = false;
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_NotFull;
+    std::condition_variable m_NotEmpty;
+    Sums m_Sum;
+    Clock::time_point m_LastPop;
+    bool m_Popped = false;
+};
+
+#endif //PROJECT_BASE_FRAMEQUEUE_H
@@ -0,0 +1,226 @@
+#ifndef PROJECT_BASE_FRUSTUM_H
+#define PROJECT_BASE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// The six planes of a view frustum, normals pointing inwards and normalized,
+// so plane.xyz . p + plane.w is the signed distance of p from the plane.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Gribb-Hartmann extraction from a projection * view matrix
+    static Frustum fromMatrix(const glm::mat4 &m) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i) {
+            rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        }
+        Frustum frustum;
+        frustum.planes[0] = rows[3] + rows[0]; // left
+        frustum.planes[1] = rows[3] - rows[0]; // right
+        frustum.planes[2] = rows[3] + rows[1]; // bottom
+        frustum.planes[3] = rows[3] - rows[1]; // top
+        frustum.planes[4] = rows[3] + rows[2]; // near
+        frustum.planes[5] = rows[3] - rows[2]; // far
+        for (glm::vec4 &plane : frustum.planes) {
+            plane = plane / glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    bool intersectsSphere(const glm::vec3 &center, float radius) const {
+        for (const glm::vec4 &plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w <= -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Bounding sphere of a transformed mesh: the center moves with the transform and the
+// radius grows with its largest axis scale, so the sphere still encloses the mesh.
+inline void transformSphere(const glm::mat4 &transform, const glm::vec3 &center, float radius,
+                            glm::vec3 &worldCenter, float &worldRadius) {
+    worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+    float scale = std::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                           std::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                                    glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))));
+    worldRadius = radius * std::sqrt(scale);
+}
+
+// how many spheres FrustumCuller tests per instruction
+enum class CullKernel {
+    Scalar,
+    SSE,
+    AVX
+};
+
+// Tests many bounding spheres against a frustum at once. Spheres are kept as separate
+// x, y, z and radius arrays so the kernel tests 8 (AVX) or 4 (SSE) of them per plane
+// with no shuffling; other targets use the scalar loop. Every kernel evaluates the plane
+// distances in the same order, so they agree on spheres that just touch a plane.
+class FrustumCuller {
+public:
+    // the widest kernel the target was compiled for, what cull() uses by default
+    static CullKernel widestKernel() {
+#if defined(__AVX__)
+        return CullKernel::AVX;
+#elif defined(__SSE__) || defined(_M_X64)
+        return CullKernel::SSE;
+#else
+        return CullKernel::Scalar;
+#endif
+    }
+
+    void clear() {
+        m_Count = 0;
+    }
+
+    void reserve(std::size_t count) {
+        count = padded(count);
+        m_X.reserve(count);
+        m_Y.reserve(count);
+        m_Z.reserve(count);
+        m_Radius.reserve(count);
+    }
+
+    // returns the index cull() reports the sphere's visibility under
+    std::size_t add(const glm::vec3 &center, float radius) {
+        if (m_Count == m_X.size()) {
+            // grow a whole vector width at a time so the kernel never reads past the end
+            std::size_t size = padded(m_Count + 1);
+            m_X.resize(size, 0.0f);
+            m_Y.resize(size, 0.0f);
+            m_Z.resize(size, 0.0f);
+            m_Radius.resize(size, 0.0f);
+        }
+        m_X[m_Count] = center.x;
+        m_Y[m_Count] = center.y;
+        m_Z[m_Count] = center.z;
+        m_Radius[m_Count] = radius;
+        return m_Count++;
+    }
+
+    std::size_t size() const {
+        return m_Count;
+    }
+
+    // fills visible() with 1 for every sphere that intersects the frustum, 0 otherwise. A kernel
+    // wider than widestKernel() runs as the widest one there is.
+    void cull(const Frustum &frustum, CullKernel kernel = widestKernel()) {
+        m_Visible.resize(m_X.size());
+        std::size_t i = 0;
+#if defined(__AVX__)
+        if (kernel == CullKernel::AVX) {
+            i = cullAVX(frustum);
+        }
+#endif
+#if defined(__SSE__) || defined(_M_X64)
+        if (kernel != CullKernel::Scalar && i == 0) {
+            i = cullSSE(frustum);
+        }
+#endif
+        for (; i < m_Count; ++i) {
+            m_Visible[i] = inside(frustum, m_X[i], m_Y[i], m_Z[i], m_Radius[i]);
+        }
+        // slots past m_Count hold stale spheres, their results are dropped here
+        m_Visible.resize(m_Count);
+        m_VisibleCount = (std::size_t) std::count(m_Visible.begin(), m_Visible.end(), 1);
+    }
+
+    const std::vector<uint8_t> &visible() const {
+        return m_Visible;
+    }
+
+    std::size_t visibleCount() const {
+        return m_VisibleCount;
+    }
+
+    std::size_t culledCount() const {
+        return m_Visible.size() - m_VisibleCount;
+    }
+
+private:
+    std::vector<float> m_X;
+    std::vector<float> m_Y;
+    std::vector<float> m_Z;
+    std::vector<float> m_Radius;
+    std::size_t m_Count = 0;
+    std::vector<uint8_t> m_Visible;
+    std::size_t m_VisibleCount = 0;
+
+    static std::size_t padded(std::size_t count) {
+        return (count + 7) & ~(std::size_t) 7;
+    }
+
+    // one sphere, with the sums grouped like the SIMD kernels group them
+    static bool inside(const Frustum &frustum, float x, float y, float z, float radius) {
+        for (const glm::vec4 &plane : frustum.planes) {
+            if (!((x * plane.x + y * plane.y) + (z * plane.z + plane.w) > -radius)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // lane mask of four spheres to their four visibility bytes
+    static void storeMask(uint8_t *visible, int mask) {
+        static const uint32_t bytes[16] = {
+                0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+                0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101};
+        std::memcpy(visible, &bytes[mask & 0xF], 4);
+    }
+
+#if defined(__AVX__)
+    std::size_t cullAVX(const Frustum &frustum) {
+        for (std::size_t i = 0; i < m_Count; i += 8) {
+            __m256 x = _mm256_loadu_ps(&m_X[i]);
+            __m256 y = _mm256_loadu_ps(&m_Y[i]);
+            __m256 z = _mm256_loadu_ps(&m_Z[i]);
+            __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&m_Radius[i]));
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (const glm::vec4 &plane : frustum.planes) {
+                __m256 distance = _mm256_add_ps(
+                        _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+                        _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GT_OQ));
+            }
+            int mask = _mm256_movemask_ps(inside);
+            storeMask(&m_Visible[i], mask);
+            storeMask(&m_Visible[i + 4], mask >> 4);
+        }
+        return m_Count;
+    }
+#endif
+#if defined(__SSE__) || defined(_M_X64)
+    std::size_t cullSSE(const Frustum &frustum) {
+        for (std::size_t i = 0; i < m_Count; i += 4) {
+            __m128 x = _mm_loadu_ps(&m_X[i]);
+            __m128 y = _mm_loadu_ps(&m_Y[i]);
+            __m128 z = _mm_loadu_ps(&m_Z[i]);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_Radius[i]));
+            __m128 inside = _mm_cmpeq_ps(x, x); // all ones unless x is NaN
+            for (const glm::vec4 &plane : frustum.planes) {
+                __m128 distance = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                        _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+                inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negativeRadius));
+            }
+            storeMask(&m_Visible[i], _mm_movemask_ps(inside));
+        }
+        return m_Count;
+    }
+#endif
+};
+
+#endif //PROJECT_BASE_FRUSTUM_H
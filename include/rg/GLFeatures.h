@@ -0,0 +1,147 @@
+#ifndef PROJECT_BASE_GLFEATURES_H
+#define PROJECT_BASE_GLFEATURES_H
+
+#include <glad/glad.h>
+#include <cstring>
+#include <cstdint>
+
+// enums and entry points newer than the GL 3.3 core profile glad was generated for
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+#define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8D6A
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+typedef void (APIENTRYP PFN_MULTIDRAWELEMENTSINDIRECT)(GLenum mode, GLenum type, const void *indirect,
+                                                       GLsizei drawCount, GLsizei stride);
+typedef uint64_t (APIENTRYP PFN_GETTEXTUREHANDLE)(GLuint texture);
+typedef void (APIENTRYP PFN_MAKETEXTUREHANDLERESIDENT)(uint64_t handle);
+typedef void (APIENTRYP PFN_DISPATCHCOMPUTE)(GLuint x, GLuint y, GLuint z);
+typedef void (APIENTRYP PFN_MEMORYBARRIER)(GLbitfield barriers);
+typedef void (APIENTRYP PFN_BUFFERSTORAGE)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRYP PFN_BINDIMAGETEXTURE)(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+                                              GLint layer, GLenum access, GLenum format);
+typedef void (APIENTRYP PFN_GETPROGRAMBINARY)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat,
+                                              void *binary);
+typedef void (APIENTRYP PFN_PROGRAMBINARY)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFN_PROGRAMPARAMETERI)(GLuint program, GLenum pname, GLint value);
+
+// Optional features of the current context. load() must run once after gladLoadGLLoader;
+// a feature is only reported when its entry points were actually found, so code can
+// branch on the flag and fall back to the GL 3.3 path otherwise.
+class GLFeatures {
+public:
+    int majorVersion = 3;
+    int minorVersion = 3;
+
+    // glMultiDrawElementsIndirect with base instances (GL 4.3 or ARB_multi_draw_indirect)
+    bool multiDrawIndirect = false;
+    PFN_MULTIDRAWELEMENTSINDIRECT multiDrawElementsIndirect = nullptr;
+
+    // 64-bit texture handles usable as samplers in shaders (ARB_bindless_texture)
+    bool bindlessTexture = false;
+    PFN_GETTEXTUREHANDLE getTextureHandle = nullptr;
+    PFN_MAKETEXTUREHANDLERESIDENT makeTextureHandleResident = nullptr;
+
+    // compute shaders with shader storage buffers and image stores (GL 4.3)
+    bool computeShader = false;
+    PFN_DISPATCHCOMPUTE dispatchCompute = nullptr;
+    PFN_MEMORYBARRIER memoryBarrier = nullptr;
+    PFN_BINDIMAGETEXTURE bindImageTexture = nullptr;
+
+    // immutable buffers that stay mapped while the GPU reads them (GL 4.4 or ARB_buffer_storage)
+    bool persistentMapping = false;
+    PFN_BUFFERSTORAGE bufferStorage = nullptr;
+
+    // linked programs saved and restored as driver binaries (GL 4.1 or ARB_get_program_binary),
+    // only reported if the driver offers at least one binary format
+    bool programBinaries = false;
+    PFN_GETPROGRAMBINARY getProgramBinary = nullptr;
+    PFN_PROGRAMBINARY programBinary = nullptr;
+    PFN_PROGRAMPARAMETERI programParameteri = nullptr;
+
+    static GLFeatures &current() {
+        static GLFeatures features;
+        return features;
+    }
+
+    void load(GLADloadproc loader) {
+        glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+        glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+
+        if (atLeast(4, 3) || hasExtension("GL_ARB_multi_draw_indirect")) {
+            multiDrawElementsIndirect = (PFN_MULTIDRAWELEMENTSINDIRECT) loader("glMultiDrawElementsIndirect");
+            multiDrawIndirect = multiDrawElementsIndirect != nullptr;
+        }
+        if (atLeast(4, 0) && hasExtension("GL_ARB_bindless_texture")) {
+            getTextureHandle = (PFN_GETTEXTUREHANDLE) loader("glGetTextureHandleARB");
+            makeTextureHandleResident = (PFN_MAKETEXTUREHANDLERESIDENT) loader("glMakeTextureHandleResidentARB");
+            bindlessTexture = getTextureHandle != nullptr && makeTextureHandleResident != nullptr;
+        }
+        if (atLeast(4, 3)) {
+            dispatchCompute = (PFN_DISPATCHCOMPUTE) loader("glDispatchCompute");
+            memoryBarrier = (PFN_MEMORYBARRIER) loader("glMemoryBarrier");
+            bindImageTexture = (PFN_BINDIMAGETEXTURE) loader("glBindImageTexture");
+            computeShader = dispatchCompute != nullptr && memoryBarrier != nullptr && bindImageTexture != nullptr;
+        }
+        if (atLeast(4, 4) || hasExtension("GL_ARB_buffer_storage")) {
+            bufferStorage = (PFN_BUFFERSTORAGE) loader("glBufferStorage");
+            persistentMapping = bufferStorage != nullptr;
+        }
+        if (atLeast(4, 1) || hasExtension("GL_ARB_get_program_binary")) {
+            getProgramBinary = (PFN_GETPROGRAMBINARY) loader("glGetProgramBinary");
+            programBinary = (PFN_PROGRAMBINARY) loader("glProgramBinary");
+            programParameteri = (PFN_PROGRAMPARAMETERI) loader("glProgramParameteri");
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            programBinaries = getProgramBinary != nullptr && programBinary != nullptr &&
+                            programParameteri != nullptr && formats > 0;
+        }
+    }
+
+    bool atLeast(int major, int minor) const {
+        return majorVersion > major || (majorVersion == major && minorVersion >= minor);
+    }
+
+    bool hasExtension(const char *name) const {
+        int count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (int i = 0; i < count; ++i) {
+            const char *extension = (const char *) glGetStringi(GL_EXTENSIONS, i);
+            if (extension && std::strcmp(extension, name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    GLFeatures() = default;
+};
+
+#endif //PROJECT_BASE_GLFEATURES_H
@@ -0,0 +1,208 @@
+#ifndef PROJECT_BASE_GLSTATE_H
+#define PROJECT_BASE_GLSTATE_H
+
+#include <glad/glad.h>
+#include <iostream>
+
+#define GL_STATE_TEXTURE_UNITS 16
+
+// calls that went through GLState, and how many of them matched the tracked state and were dropped
+struct GLStateCounters {
+    unsigned long issued = 0;
+    unsigned long skipped = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &out, const GLStateCounters &counters) {
+    return out << counters.issued << " state calls issued, " << counters.skipped << " redundant calls skipped";
+}
+
+// Shadow copy of the GL state the engine touches. Every bind/enable goes through here
+// and is only forwarded to GL when it changes something; all code sharing the context has
+// to use it, otherwise call invalidate() before relying on the tracked state again.
+class GLState {
+public:
+    // the one context of the application
+    static GLState &current() {
+        static GLState state;
+        return state;
+    }
+
+    void useProgram(unsigned int program) {
+        if (!changed(m_Program, program)) return;
+        glUseProgram(program);
+    }
+
+    // the program in use as far as the cache knows
+    unsigned int program() const {
+        return m_Program;
+    }
+
+    void bindVertexArray(unsigned int vao) {
+        if (!changed(m_VertexArray, vao)) return;
+        glBindVertexArray(vao);
+    }
+
+    // a unit has a binding per target, e.g. a 2D array and a 2D texture can share unit 0.
+    // Units from GL_STATE_TEXTURE_UNITS on and untracked targets are always bound.
+    void bindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+        int slot = targetSlot(target);
+        if (unit < GL_STATE_TEXTURE_UNITS && slot >= 0) {
+            if (!changed(m_Textures[unit].textures[slot], texture)) return;
+        } else {
+            ++m_Counters.issued;
+        }
+        activeTexture(unit);
+        glBindTexture(target, texture);
+    }
+
+    // GL_FRAMEBUFFER binds both the draw and the read framebuffer
+    void bindFramebuffer(GLenum target, unsigned int framebuffer) {
+        bool draw = target != GL_READ_FRAMEBUFFER;
+        bool read = target != GL_DRAW_FRAMEBUFFER;
+        if ((!draw || m_DrawFramebuffer == framebuffer) && (!read || m_ReadFramebuffer == framebuffer)) {
+            ++m_Counters.skipped;
+            return;
+        }
+        if (draw) m_DrawFramebuffer = framebuffer;
+        if (read) m_ReadFramebuffer = framebuffer;
+        ++m_Counters.issued;
+        glBindFramebuffer(target, framebuffer);
+    }
+
+    void enable(GLenum capability) {
+        setCapability(capability, true);
+    }
+
+    void disable(GLenum capability) {
+        setCapability(capability, false);
+    }
+
+    void setCapability(GLenum capability, bool enabled) {
+        int &tracked = capabilityState(capability);
+        if (!changed(tracked, (int) enabled)) return;
+        if (enabled) glEnable(capability);
+        else glDisable(capability);
+    }
+
+    void cullFace(GLenum face) {
+        if (!changed(m_CullFace, face)) return;
+        glCullFace(face);
+    }
+
+    void depthFunc(GLenum func) {
+        if (!changed(m_DepthFunc, func)) return;
+        glDepthFunc(func);
+    }
+
+    void depthMask(bool write) {
+        if (!changed(m_DepthMask, (int) write)) return;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    // all four channels at once, nothing masks them one by one
+    void colorMask(bool write) {
+        if (!changed(m_ColorMask, (int) write)) return;
+        GLboolean value = write ? GL_TRUE : GL_FALSE;
+        glColorMask(value, value, value, value);
+    }
+
+    void blendFunc(GLenum source, GLenum destination) {
+        if (m_BlendSource == source && m_BlendDestination == destination) {
+            ++m_Counters.skipped;
+            return;
+        }
+        m_BlendSource = source;
+        m_BlendDestination = destination;
+        ++m_Counters.issued;
+        glBlendFunc(source, destination);
+    }
+
+    // forget everything, the next call of each kind is always issued
+    void invalidate() {
+        *this = GLState();
+    }
+
+    const GLStateCounters &counters() const {
+        return m_Counters;
+    }
+
+    void resetCounters() {
+        m_Counters = GLStateCounters();
+    }
+
+private:
+    static const unsigned int UNKNOWN = ~0u;
+
+    // the texture targets tracked per unit, in the order of TextureUnit::textures
+    static const int TRACKED_TARGETS = 4;
+
+    struct TextureUnit {
+        unsigned int textures[TRACKED_TARGETS] = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+    };
+
+    struct Capability {
+        GLenum capability;
+        int enabled; // -1 unknown
+    };
+
+    unsigned int m_Program = UNKNOWN;
+    unsigned int m_VertexArray = UNKNOWN;
+    unsigned int m_ActiveTexture = UNKNOWN;
+    TextureUnit m_Textures[GL_STATE_TEXTURE_UNITS];
+    unsigned int m_DrawFramebuffer = UNKNOWN;
+    unsigned int m_ReadFramebuffer = UNKNOWN;
+    Capability m_Capabilities[8] = {{GL_DEPTH_TEST, -1}, {GL_CULL_FACE, -1}, {GL_BLEND, -1}, {GL_STENCIL_TEST, -1},
+                                    {GL_MULTISAMPLE, -1}, {GL_SCISSOR_TEST, -1}, {GL_FRAMEBUFFER_SRGB, -1}, {0, -1}};
+    GLenum m_CullFace = UNKNOWN;
+    GLenum m_DepthFunc = UNKNOWN;
+    int m_DepthMask = -1;
+    int m_ColorMask = -1;
+    GLenum m_BlendSource = UNKNOWN;
+    GLenum m_BlendDestination = UNKNOWN;
+    GLStateCounters m_Counters;
+
+    GLState() = default;
+
+    // updates tracked and counts the call, returns false if it was redundant
+    template <typename T>
+    bool changed(T &tracked, T value) {
+        if (tracked == value) {
+            ++m_Counters.skipped;
+            return false;
+        }
+        tracked = value;
+        ++m_Counters.issued;
+        return true;
+    }
+
+    void activeTexture(unsigned int unit) {
+        if (m_ActiveTexture == unit) return;
+        m_ActiveTexture = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    static int targetSlot(GLenum target) {
+        switch (target) {
+            case GL_TEXTURE_2D: return 0;
+            case GL_TEXTURE_2D_ARRAY: return 1;
+            case GL_TEXTURE_2D_MULTISAMPLE: return 2;
+            case GL_TEXTURE_CUBE_MAP: return 3;
+            default: return -1;
+        }
+    }
+
+    int &capabilityState(GLenum capability) {
+        for (Capability &tracked : m_Capabilities) {
+            if (tracked.capability == capability) {
+                return tracked.enabled;
+            }
+        }
+        // the last slot takes any other capability, switching it forgets the previous one
+        Capability &other = m_Capabilities[7];
+        other.capability = capability;
+        other.enabled = -1;
+        return other.enabled;
+    }
+};
+
+#endif //PROJECT_BASE_GLSTATE_H
@@ -0,0 +1,79 @@
+#ifndef PROJECT_BASE_GPUTIMER_H
+#define PROJECT_BASE_GPUTIMER_H
+
+#include <glad/glad.h>
+
+// frames a timer query may stay in flight before its slot is reused
+#define GPU_TIMER_FRAMES 4
+
+// GPU time of one stretch of commands per frame, measured with GL_TIME_ELAPSED queries.
+// Results are read GPU_TIMER_FRAMES frames later and only once available, so timing never
+// stalls the pipeline; a result still missing by then is dropped. Only one GL_TIME_ELAPSED
+// query can be active at a time, so timers must not nest.
+class GpuTimer {
+public:
+    GpuTimer() = default;
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    ~GpuTimer() {
+        if (m_Queries[0] != 0) {
+            glDeleteQueries(GPU_TIMER_FRAMES, m_Queries);
+        }
+    }
+
+    void begin() {
+        if (m_Queries[0] == 0) {
+            glGenQueries(GPU_TIMER_FRAMES, m_Queries);
+        }
+        collect(m_Next);
+        glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_Next]);
+    }
+
+    void end() {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_Pending[m_Next] = true;
+        m_Next = (m_Next + 1) % GPU_TIMER_FRAMES;
+    }
+
+    // average over the results collected since the last reset(), 0 without any
+    double milliseconds() const {
+        return m_Samples ? m_Nanoseconds / m_Samples / 1e6 : 0.0;
+    }
+
+    unsigned int samples() const {
+        return m_Samples;
+    }
+
+    void reset() {
+        m_Nanoseconds = 0.0;
+        m_Samples = 0;
+    }
+
+private:
+    unsigned int m_Queries[GPU_TIMER_FRAMES] = {};
+    bool m_Pending[GPU_TIMER_FRAMES] = {};
+    unsigned int m_Next = 0;
+    double m_Nanoseconds = 0.0;
+    unsigned int m_Samples = 0;
+
+    // adds the slot's result if the GPU has it, the slot is free either way
+    void collect(unsigned int slot) {
+        if (!m_Pending[slot]) {
+            return;
+        }
+        m_Pending[slot] = false;
+        GLint available = 0;
+        glGetQueryObjectiv(m_Queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return;
+        }
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(m_Queries[slot], GL_QUERY_RESULT, &elapsed);
+        m_Nanoseconds += (double) elapsed;
+        ++m_Samples;
+    }
+};
+
+#endif //PROJECT_BASE_GPUTIMER_H
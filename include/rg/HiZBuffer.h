@@ -0,0 +1,134 @@
+#ifndef PROJECT_BASE_HIZBUFFER_H
+#define PROJECT_BASE_HIZBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader_c.h>
+#include <rg/GLState.h>
+#include <rg/GLFeatures.h>
+#include <algorithm>
+
+// texture unit the cull shader samples the pyramid from, the first one after the material units
+#define HIZ_TEXTURE_UNIT 4
+
+// Depth pyramid for occlusion tests on the GPU. build() resolves the depth of a rendered
+// (possibly multisampled) framebuffer and reduces it with hiz_downsample.comp: level 0 is
+// half the framebuffer size and every texel holds the farthest depth under it, so a box
+// whose nearest depth lies behind the texels covering it on screen is hidden.
+// The pyramid describes the frame it was built from; the view projection of that frame
+// is kept with it, so next frame's tests project into the right place.
+class HiZBuffer {
+public:
+    // copies the depth of framebuffer (width x height, depth24 stencil8) and reduces it
+    void build(const ComputeShader &downsample, unsigned int framebuffer, int width, int height,
+               const glm::mat4 &viewProjection) {
+        GLState &gl = GLState::current();
+        GLFeatures &features = GLFeatures::current();
+        resize(width, height);
+
+        gl.bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        gl.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_DepthFramebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+        // the pyramid's own unit, so the material units keep what the draws bound there
+        if (downsample.ID != m_DownsampleProgram) {
+            m_DownsampleProgram = downsample.ID;
+            m_SourceLocation = downsample.getUniformLocation("source");
+            m_SourceLevelLocation = downsample.getUniformLocation("sourceLevel");
+        }
+        downsample.use();
+        downsample.setInt(m_SourceLocation, HIZ_TEXTURE_UNIT);
+        for (int level = 0; level < m_Levels; ++level) {
+            // level 0 reads the depth texture, every other level the one above it
+            gl.bindTexture(HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, level == 0 ? m_DepthTexture : m_Texture);
+            downsample.setInt(m_SourceLevelLocation, level == 0 ? 0 : level - 1);
+            features.bindImageTexture(0, m_Texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            int levelWidth = std::max(1, m_Width >> level);
+            int levelHeight = std::max(1, m_Height >> level);
+            downsample.dispatch((levelWidth + 7) / 8, (levelHeight + 7) / 8);
+            features.memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+        m_ViewProjection = viewProjection;
+        m_Built = true;
+    }
+
+    bool isBuilt() const {
+        return m_Built;
+    }
+
+    // R32F texture with levels() mip levels
+    unsigned int texture() const {
+        return m_Texture;
+    }
+
+    int levels() const {
+        return m_Levels;
+    }
+
+    // size of level 0
+    glm::vec2 size() const {
+        return glm::vec2((float) m_Width, (float) m_Height);
+    }
+
+    const glm::mat4 &viewProjection() const {
+        return m_ViewProjection;
+    }
+
+private:
+    unsigned int m_DepthFramebuffer = 0;
+    unsigned int m_DepthTexture = 0;
+    unsigned int m_Texture = 0;
+    int m_SourceWidth = 0;
+    int m_SourceHeight = 0;
+    int m_Width = 0;
+    int m_Height = 0;
+    int m_Levels = 0;
+    glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+    bool m_Built = false;
+    // locations in the downsample program, looked up the first time it builds the pyramid
+    unsigned int m_DownsampleProgram = 0;
+    int m_SourceLocation = -1;
+    int m_SourceLevelLocation = -1;
+
+    void resize(int width, int height) {
+        if (width == m_SourceWidth && height == m_SourceHeight) {
+            return;
+        }
+        GLState &gl = GLState::current();
+        if (m_DepthFramebuffer == 0) {
+            glGenFramebuffers(1, &m_DepthFramebuffer);
+            glGenTextures(1, &m_DepthTexture);
+            glGenTextures(1, &m_Texture);
+        }
+        m_SourceWidth = width;
+        m_SourceHeight = height;
+
+        // same format as the scene's depth renderbuffer, depth blits don't convert
+        gl.bindTexture(HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, m_DepthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL,
+                     GL_UNSIGNED_INT_24_8, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        gl.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_DepthFramebuffer);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_DepthTexture, 0);
+        glDrawBuffer(GL_NONE);
+
+        m_Width = std::max(1, width / 2);
+        m_Height = std::max(1, height / 2);
+        m_Levels = 1;
+        while ((m_Width >> m_Levels) > 0 || (m_Height >> m_Levels) > 0) {
+            ++m_Levels;
+        }
+        gl.bindTexture(HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, m_Texture);
+        for (int level = 0; level < m_Levels; ++level) {
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(1, m_Width >> level), std::max(1, m_Height >> level),
+                         0, GL_RED, GL_FLOAT, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_Levels - 1);
+        m_Built = false;
+    }
+};
+
+#endif //PROJECT_BASE_HIZBUFFER_H
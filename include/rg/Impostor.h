@@ -0,0 +1,384 @@
+#ifndef PROJECT_BASE_IMPOSTOR_H
+#define PROJECT_BASE_IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/model.h>
+#include <rg/GLState.h>
+#include <rg/RenderQueue.h>
+#include <rg/StreamBuffer.h>
+#include <rg/InstanceBuffer.h> // INSTANCE_MODEL_LOCATION, INSTANCE_NORMAL_LOCATION
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+// views per side of the octahedral grid and pixels per side of one view, the atlas is their product
+#define IMPOSTOR_GRID 8
+#define IMPOSTOR_TILE_SIZE 128
+// bumped whenever the baked data changes meaning, so stale cache files are baked again
+#define IMPOSTOR_CACHE_VERSION 1u
+// per-instance attributes of impostor.vs, where instanced meshes read their model matrix
+#define IMPOSTOR_CENTER_LOCATION INSTANCE_MODEL_LOCATION
+#define IMPOSTOR_AXES_LOCATION (INSTANCE_MODEL_LOCATION + 1)
+#define IMPOSTOR_CELLS_LOCATION (INSTANCE_MODEL_LOCATION + 4)
+#define IMPOSTOR_WEIGHTS_LOCATION (INSTANCE_MODEL_LOCATION + 5)
+#define IMPOSTOR_LIGHTS_LOCATION (INSTANCE_MODEL_LOCATION + 6)
+
+// one drawn copy; fade goes from 0 (not drawn) to 1 (fully drawn) with a dither pattern,
+// so a copy can fade in over its mesh without sorting or blending
+struct ImpostorInstance {
+    glm::mat4 model;
+    float fade;
+    unsigned int lights; // light list, see LightCuller
+};
+
+// Stand-in for a model far away: the model is baked once from IMPOSTOR_GRID^2 directions
+// spread over the sphere (octahedral mapping) into a color atlas (alpha = coverage) and a
+// normal + depth atlas, both in the model's own space. Each copy is then a single quad that
+// faces the camera and blends the four baked views nearest to the viewing direction; the
+// depth moves every pixel back onto the model's surface, so impostors intersect the rest of
+// the scene like the mesh would and light the same way. Bakes are cached in a directory,
+// keyed by a hash of the model's geometry and texture paths.
+class Impostor {
+public:
+    // bakeShader is impostor_bake.vs/.fs with its diffuse sampler set to TEXTURE_DIFFUSE's unit
+    Impostor(Model &model, Shader &bakeShader, const std::string &cacheDirectory) {
+        AABB bounds = model.Bounds();
+        m_Center = bounds.center();
+        m_Radius = std::max(glm::length(bounds.max - bounds.min) * 0.5f, 1e-4f);
+        // impostor.vs works on the unit sphere around the model
+        m_Normalize = glm::scale(glm::translate(glm::mat4(1.0f), m_Center), glm::vec3(m_Radius));
+
+        createTextures();
+        std::string path = cacheDirectory + "/impostor_" + hash(model) + ".bin";
+        if (load(path)) {
+            m_Cached = true;
+        } else {
+            bake(model, bakeShader);
+            save(path);
+        }
+        const unsigned int atlases[2] = {m_ColorAtlas, m_NormalDepthAtlas};
+        for (unsigned int atlas : atlases) {
+            GLState::current().bindTexture(0, GL_TEXTURE_2D, atlas);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+    }
+
+    // draws count copies seen from viewPos with one instanced draw, shader is impostor.vs/.fs.
+    // Everything that only depends on the copy and the camera (the quad's axes, the nearest
+    // views, the normal matrix) is worked out here once per copy instead of once per vertex.
+    void Submit(RenderQueue &queue, RenderPass pass, const Shader &shader, const ImpostorInstance *instances,
+                unsigned int count, const glm::vec3 &viewPos) {
+        if (count == 0) {
+            return;
+        }
+        createQuad();
+        m_Instances.resize(count);
+        for (unsigned int i = 0; i < count; ++i) {
+            // scaled so the model's bounding sphere is the unit sphere
+            glm::mat4 model = instances[i].model * m_Normalize;
+            glm::mat4 inverse = glm::inverse(model);
+            // the camera in the copy's own space, where the sphere's center is the origin
+            glm::vec3 direction = glm::normalize(glm::vec3(inverse * glm::vec4(viewPos, 1.0f)));
+            // same basis as the bake's lookAt, so the quad shows the views upright
+            glm::vec3 up = viewUp(direction);
+            glm::vec3 right = glm::normalize(glm::cross(up, direction));
+            up = glm::cross(direction, right);
+
+            QuadInstance &quad = m_Instances[i];
+            quad.center = glm::vec4(glm::vec3(model[3]), instances[i].fade);
+            quad.right = glm::vec3(model * glm::vec4(right, 0.0f));
+            quad.up = glm::vec3(model * glm::vec4(up, 0.0f));
+            quad.depth = glm::vec3(model * glm::vec4(direction, 0.0f));
+            glm::vec2 grid = (octahedralPosition(direction) * 0.5f + glm::vec2(0.5f)) * (float) IMPOSTOR_GRID - glm::vec2(0.5f);
+            for (int axis = 0; axis < 2; ++axis) {
+                int first = std::min(std::max((int) std::floor(grid[axis]), 0), IMPOSTOR_GRID - 1);
+                quad.cells[axis] = first;
+                quad.cells[axis + 2] = std::min(first + 1, IMPOSTOR_GRID - 1);
+                quad.weights[axis] = std::min(std::max(grid[axis] - first, 0.0f), 1.0f);
+            }
+            quad.lights = instances[i].lights;
+            // the normal matrix is the transposed inverse, which is already at hand
+            quad.normalMatrix = glm::transpose(glm::mat3(inverse));
+        }
+        setInstanceAttributes(StreamBuffer::current().write(m_Instances.data(), count * sizeof(QuadInstance)));
+
+        DrawItem item;
+        item.program = shader.handle;
+        item.vao = m_QuadVertexArray;
+        item.textures[0] = m_ColorAtlasHandle;
+        item.textures[1] = m_NormalDepthAtlasHandle;
+        item.mode = GL_TRIANGLE_STRIP;
+        item.count = 4;
+        item.instanceCount = count;
+        // impostor.fs writes gl_FragDepth and dithers with discard
+        item.ownDepth = true;
+        queue.submit(pass, item, glm::vec3(m_Instances[0].center));
+    }
+
+    // true if the atlases came from the cache instead of being baked
+    bool cached() const {
+        return m_Cached;
+    }
+
+    // model space center and radius of the sphere the views were baked around
+    const glm::vec3 &center() const {
+        return m_Center;
+    }
+
+    float radius() const {
+        return m_Radius;
+    }
+
+private:
+    // one copy as impostor.vs reads it
+    struct QuadInstance {
+        glm::vec4 center;     // world center of the bounding sphere, w = fade
+        glm::vec3 right;      // world offsets from the center to the quad's right and top edges
+        glm::vec3 up;
+        glm::vec3 depth;      // world offset from the center to the front of the sphere
+        GLint cells[4];       // the two columns and rows of the nearest baked views
+        glm::vec2 weights;    // blend between them
+        GLuint lights;        // light list, see LightCuller
+        glm::mat3 normalMatrix;
+    };
+
+    unsigned int m_ColorAtlas = 0;
+    unsigned int m_NormalDepthAtlas = 0;
+    unsigned int m_QuadVAO = 0;
+    unsigned int m_QuadVBO = 0;
+    // the same objects as draw items refer to them
+    TextureHandle m_ColorAtlasHandle;
+    TextureHandle m_NormalDepthAtlasHandle;
+    VertexArrayHandle m_QuadVertexArray;
+    std::vector<QuadInstance> m_Instances;
+    glm::vec3 m_Center;
+    float m_Radius;
+    glm::mat4 m_Normalize;
+    bool m_Cached = false;
+
+    static int atlasSize() {
+        return IMPOSTOR_GRID * IMPOSTOR_TILE_SIZE;
+    }
+
+    // direction of the view at an octahedral map position in [-1, 1]^2, the inverse of octahedralPosition
+    static glm::vec3 octahedralDirection(float x, float y) {
+        glm::vec3 direction(x, 1.0f - std::fabs(x) - std::fabs(y), y);
+        if (direction.y < 0.0f) {
+            direction.x = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            direction.z = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return glm::normalize(direction);
+    }
+
+    // position of a direction on the octahedral map
+    static glm::vec2 octahedralPosition(glm::vec3 direction) {
+        direction = direction / (std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z));
+        glm::vec2 position(direction.x, direction.z);
+        if (direction.y < 0.0f) {
+            position = glm::vec2((1.0f - std::fabs(direction.z)) * (direction.x >= 0.0f ? 1.0f : -1.0f),
+                                 (1.0f - std::fabs(direction.x)) * (direction.z >= 0.0f ? 1.0f : -1.0f));
+        }
+        return position;
+    }
+
+    // up vector of a view, used by the bake and by Submit alike
+    static glm::vec3 viewUp(const glm::vec3 &direction) {
+        return std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    void createTextures() {
+        GLState &gl = GLState::current();
+        unsigned int *atlases[2] = {&m_ColorAtlas, &m_NormalDepthAtlas};
+        for (unsigned int *atlas : atlases) {
+            glGenTextures(1, atlas);
+            gl.bindTexture(0, GL_TEXTURE_2D, *atlas);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize(), atlasSize(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            // stop while a view is still a few pixels wide, smaller levels would mix neighbouring views
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 4);
+        }
+        m_ColorAtlasHandle = Resources::current().textures().add(m_ColorAtlas);
+        m_NormalDepthAtlasHandle = Resources::current().textures().add(m_NormalDepthAtlas);
+    }
+
+    void bake(Model &model, Shader &bakeShader) {
+        GLState &gl = GLState::current();
+        unsigned int framebuffer, depth;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &depth);
+        gl.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_ColorAtlas, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_NormalDepthAtlas, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize(), atlasSize());
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        const GLenum attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "ERROR::IMPOSTOR:: Bake framebuffer is not complete!" << std::endl;
+        }
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glViewport(0, 0, atlasSize(), atlasSize());
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // thin parts are seen from both sides
+        gl.disable(GL_CULL_FACE);
+        gl.enable(GL_DEPTH_TEST);
+        bakeShader.use();
+        int transformLocation = bakeShader.getUniformLocation("viewProjection");
+        // orthographic, from the sphere's front (depth 0) to its back (depth 1)
+        glm::mat4 projection = glm::ortho(-m_Radius, m_Radius, -m_Radius, m_Radius, 0.0f, 2.0f * m_Radius);
+        for (int y = 0; y < IMPOSTOR_GRID; ++y) {
+            for (int x = 0; x < IMPOSTOR_GRID; ++x) {
+                glm::vec3 direction = octahedralDirection((x + 0.5f) / IMPOSTOR_GRID * 2.0f - 1.0f,
+                                                          (y + 0.5f) / IMPOSTOR_GRID * 2.0f - 1.0f);
+                glm::mat4 view = glm::lookAt(m_Center + direction * m_Radius, m_Center, viewUp(direction));
+                glm::mat4 transform = projection * view;
+                glUniformMatrix4fv(transformLocation, 1, GL_FALSE, &transform[0][0]);
+                glViewport(x * IMPOSTOR_TILE_SIZE, y * IMPOSTOR_TILE_SIZE, IMPOSTOR_TILE_SIZE, IMPOSTOR_TILE_SIZE);
+                model.Draw(bakeShader);
+            }
+        }
+
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        gl.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+
+    // FNV-1a over everything that changes the bake
+    static std::string hash(const Model &model) {
+        uint64_t value = 14695981039346656037ull;
+        auto add = [&value](const void *data, std::size_t size) {
+            const unsigned char *bytes = (const unsigned char *) data;
+            for (std::size_t i = 0; i < size; ++i) {
+                value = (value ^ bytes[i]) * 1099511628211ull;
+            }
+        };
+        const unsigned int parameters[3] = {IMPOSTOR_CACHE_VERSION, IMPOSTOR_GRID, IMPOSTOR_TILE_SIZE};
+        add(parameters, sizeof(parameters));
+        for (const Mesh &mesh : model.meshes) {
+            add(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            add(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        }
+        for (unsigned int id : model.texturePaths) {
+            const std::string &path = Resources::current().strings().str(id);
+            add(path.data(), path.size());
+        }
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << value;
+        return name.str();
+    }
+
+    struct CacheHeader {
+        char magic[4];
+        unsigned int version;
+        unsigned int grid;
+        unsigned int tileSize;
+    };
+
+    bool load(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        CacheHeader header;
+        if (!file || !file.read((char *) &header, sizeof(header)) ||
+            std::string(header.magic, 4) != "RGIM" || header.version != IMPOSTOR_CACHE_VERSION ||
+            header.grid != IMPOSTOR_GRID || header.tileSize != IMPOSTOR_TILE_SIZE) {
+            return false;
+        }
+        std::vector<unsigned char> pixels(atlasSize() * atlasSize() * 4 * 2);
+        if (!file.read((char *) pixels.data(), pixels.size())) {
+            return false;
+        }
+        GLState &gl = GLState::current();
+        gl.bindTexture(0, GL_TEXTURE_2D, m_ColorAtlas);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, atlasSize(), atlasSize(), GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        gl.bindTexture(0, GL_TEXTURE_2D, m_NormalDepthAtlas);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, atlasSize(), atlasSize(), GL_RGBA, GL_UNSIGNED_BYTE,
+                        pixels.data() + pixels.size() / 2);
+        return true;
+    }
+
+    // a failed save only costs a bake on the next start
+    void save(const std::string &path) {
+        std::vector<unsigned char> pixels(atlasSize() * atlasSize() * 4 * 2);
+        GLState &gl = GLState::current();
+        gl.bindTexture(0, GL_TEXTURE_2D, m_ColorAtlas);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        gl.bindTexture(0, GL_TEXTURE_2D, m_NormalDepthAtlas);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data() + pixels.size() / 2);
+        std::ofstream file(path, std::ios::binary);
+        CacheHeader header = {{'R', 'G', 'I', 'M'}, IMPOSTOR_CACHE_VERSION, IMPOSTOR_GRID, IMPOSTOR_TILE_SIZE};
+        file.write((const char *) &header, sizeof(header));
+        file.write((const char *) pixels.data(), pixels.size());
+        if (!file) {
+            std::cout << "WARNING::IMPOSTOR:: Could not write " << path << std::endl;
+        }
+    }
+
+    // corners of [-1, 1]^2 as a strip
+    void createQuad() {
+        if (m_QuadVAO != 0) {
+            return;
+        }
+        const float corners[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+        glGenVertexArrays(1, &m_QuadVAO);
+        glGenBuffers(1, &m_QuadVBO);
+        GLState::current().bindVertexArray(m_QuadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_QuadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *) 0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        VertexArrayInfo info;
+        info.count = 4;
+        m_QuadVertexArray = Resources::current().vertexArrays().add(m_QuadVAO, info);
+    }
+
+    // points the quad's per-instance attributes at this frame's QuadInstances in the stream buffer
+    void setInstanceAttributes(const StreamRange &range) {
+        GLState::current().bindVertexArray(m_QuadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, range.buffer);
+        std::size_t base = range.offset;
+        glVertexAttribPointer(IMPOSTOR_CENTER_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance),
+                              (void *) (base + offsetof(QuadInstance, center)));
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            glVertexAttribPointer(IMPOSTOR_AXES_LOCATION + axis, 3, GL_FLOAT, GL_FALSE, sizeof(QuadInstance),
+                                  (void *) (base + offsetof(QuadInstance, right) + axis * sizeof(glm::vec3)));
+        }
+        glVertexAttribIPointer(IMPOSTOR_CELLS_LOCATION, 4, GL_INT, sizeof(QuadInstance),
+                               (void *) (base + offsetof(QuadInstance, cells)));
+        glVertexAttribPointer(IMPOSTOR_WEIGHTS_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(QuadInstance),
+                              (void *) (base + offsetof(QuadInstance, weights)));
+        glVertexAttribIPointer(IMPOSTOR_LIGHTS_LOCATION, 1, GL_UNSIGNED_INT, sizeof(QuadInstance),
+                               (void *) (base + offsetof(QuadInstance, lights)));
+        for (unsigned int column = 0; column < 3; ++column) {
+            glVertexAttribPointer(INSTANCE_NORMAL_LOCATION + column, 3, GL_FLOAT, GL_FALSE, sizeof(QuadInstance),
+                                  (void *) (base + offsetof(QuadInstance, normalMatrix) + column * sizeof(glm::vec3)));
+        }
+        const unsigned int locations[] = {IMPOSTOR_CENTER_LOCATION, IMPOSTOR_AXES_LOCATION, IMPOSTOR_AXES_LOCATION + 1,
+                                          IMPOSTOR_AXES_LOCATION + 2, IMPOSTOR_CELLS_LOCATION, IMPOSTOR_WEIGHTS_LOCATION,
+                                          IMPOSTOR_LIGHTS_LOCATION, INSTANCE_NORMAL_LOCATION,
+                                          INSTANCE_NORMAL_LOCATION + 1, INSTANCE_NORMAL_LOCATION + 2};
+        for (unsigned int location : locations) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif //PROJECT_BASE_IMPOSTOR_H
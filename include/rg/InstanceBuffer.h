@@ -0,0 +1,105 @@
+#ifndef PROJECT_BASE_INSTANCEBUFFER_H
+#define PROJECT_BASE_INSTANCEBUFFER_H
+
+#include <glad/glad.h>
+#include <rg/GLState.h>
+#include <rg/StreamBuffer.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// first attribute location of the per-instance model matrix (a mat4 takes locations 5 to 8),
+// vertex shaders declare it as `layout (location = 5) in mat4 aModel;`
+#define INSTANCE_MODEL_LOCATION 5
+// first attribute location of the per-instance normal matrix (a mat3 takes locations 12 to 14),
+// vertex shaders that light declare it as `layout (location = 12) in mat3 aNormalMatrix;`
+#define INSTANCE_NORMAL_LOCATION 12
+
+// matrix that takes model space normals to world space, the inverse transpose of the model's upper 3x3
+inline glm::mat3 normalMatrix(const glm::mat4 &model) {
+    return glm::transpose(glm::inverse(glm::mat3(model)));
+}
+
+// one instance as the vertex shader reads it
+struct InstanceTransform {
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+};
+
+// Per-instance model matrices streamed through the StreamBuffer, each with its normal matrix so
+// vertex shaders don't invert a matrix per vertex.
+// Draws issued right away attach it to a VAO once; every instanced draw from that VAO then reads
+// the matrices of the last upload. Attaching again with firstInstance makes instance 0 read the
+// matrix at that index, for draws that can't pass a base instance (GL 3.3).
+// Queued draws keep the range upload() returns in DrawItem::instances instead, since the queue
+// only executes after every upload of the frame.
+class InstanceBuffer {
+public:
+    void attach(unsigned int vao, std::size_t firstInstance = 0) {
+        for (Attachment &attachment : m_Attachments) {
+            if (attachment.vao == vao) {
+                attachment.firstInstance = firstInstance;
+                point(attachment);
+                return;
+            }
+        }
+        m_Attachments.push_back({vao, firstInstance});
+        point(m_Attachments.back());
+    }
+
+    // computes every instance's normal matrix once here instead of once per vertex. Every upload
+    // lands somewhere else in the ring, so the attached VAOs are pointed at it again.
+    StreamRange upload(const glm::mat4 *transforms, std::size_t count) {
+        m_Staging.resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            m_Staging[i].model = transforms[i];
+            m_Staging[i].normalMatrix = normalMatrix(transforms[i]);
+        }
+        m_Range = StreamBuffer::current().write(m_Staging.data(), count * sizeof(InstanceTransform));
+        for (const Attachment &attachment : m_Attachments) {
+            point(attachment);
+        }
+        return m_Range;
+    }
+
+    // points the vao's instance attributes at InstanceTransforms written to range
+    static void setInstanceAttributes(unsigned int vao, const StreamRange &range, std::size_t firstInstance = 0) {
+        GLState::current().bindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, range.buffer);
+        std::size_t base = range.offset + firstInstance * sizeof(InstanceTransform);
+        for (unsigned int column = 0; column < 4; ++column) {
+            unsigned int location = INSTANCE_MODEL_LOCATION + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                                  (void *) (base + offsetof(InstanceTransform, model) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        for (unsigned int column = 0; column < 3; ++column) {
+            unsigned int location = INSTANCE_NORMAL_LOCATION + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                                  (void *) (base + offsetof(InstanceTransform, normalMatrix) + column * sizeof(glm::vec3)));
+            glVertexAttribDivisor(location, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+private:
+    struct Attachment {
+        unsigned int vao;
+        std::size_t firstInstance;
+    };
+
+    std::vector<Attachment> m_Attachments;
+    StreamRange m_Range;
+    std::vector<InstanceTransform> m_Staging;
+
+    // nothing to point at before the first upload
+    void point(const Attachment &attachment) const {
+        if (m_Range.buffer != 0) {
+            setInstanceAttributes(attachment.vao, m_Range, attachment.firstInstance);
+        }
+    }
+};
+
+#endif //PROJECT_BASE_INSTANCEBUFFER_H
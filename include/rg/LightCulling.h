@@ -0,0 +1,143 @@
+#ifndef PROJECT_BASE_LIGHTCULLING_H
+#define PROJECT_BASE_LIGHTCULLING_H
+
+#include <glm/glm.hpp>
+#include <rg/UniformBuffer.h> // LightsBlock
+#include <rg/BVH.h>           // AABB
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+// a light ends where it adds less than one step of an 8-bit channel
+#define LIGHT_CUTOFF (1.0f / 256.0f)
+
+// Light list of one draw, packed into a uint the shaders unpack: the number of point lights
+// in bits 0-3, their indices 4 bits each from bit 4 up, and LIGHT_LIST_SPOT if the spot light
+// reaches the object too.
+#define LIGHT_LIST_SPOT 0x80000000u
+
+static_assert(NR_POINT_LIGHTS <= 6, "a light list holds at most 6 point light indices");
+
+// list with every light, for draws that aren't culled
+inline unsigned int allLights() {
+    unsigned int list = NR_POINT_LIGHTS | LIGHT_LIST_SPOT;
+    for (unsigned int i = 0; i < NR_POINT_LIGHTS; ++i) {
+        list |= i << (4 + 4 * i);
+    }
+    return list;
+}
+
+// distance at which a light of the given peak intensity, divided by
+// constant + linear * d + quadratic * d^2, falls below cutoff
+inline float attenuationRadius(float constant, float linear, float quadratic, float intensity,
+                               float cutoff = LIGHT_CUTOFF) {
+    float attenuation = intensity / cutoff;
+    if (attenuation <= constant) {
+        return 0.0f;
+    }
+    if (quadratic > 0.0f) {
+        return (-linear + std::sqrt(linear * linear + 4.0f * quadratic * (attenuation - constant))) / (2.0f * quadratic);
+    }
+    if (linear > 0.0f) {
+        return (attenuation - constant) / linear;
+    }
+    return std::numeric_limits<float>::max();
+}
+
+// lights tested by the last update() and how many of them the draws kept
+struct LightCullingStats {
+    unsigned int objects = 0;
+    unsigned int kept = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &out, const LightCullingStats &stats) {
+    unsigned int total = stats.objects * (NR_POINT_LIGHTS + 1);
+    unsigned int rate = total ? stats.kept * 100 / total : 0;
+    return out << stats.kept << " of " << total << " light evaluations kept for " << stats.objects
+               << " objects (" << rate << "%)";
+}
+
+// Bounds every light by where its attenuation drops below LIGHT_CUTOFF: a sphere for point
+// lights, a cone cut off at that distance for the spot light. A draw's light list holds only
+// the lights whose volume touches its world bounds, so a fragment pays for the lights around
+// it rather than for every light in the scene.
+class LightCuller {
+public:
+    // call whenever the lights change, before any lightsFor()
+    void update(const LightsBlock &lights) {
+        for (unsigned int i = 0; i < NR_POINT_LIGHTS; ++i) {
+            const PointLightBlock &light = lights.pointLights[i];
+            m_PointPositions[i] = light.position;
+            m_PointRadii[i] = attenuationRadius(light.constant, light.linear, light.quadratic,
+                                                peak(light.ambient + light.diffuse + light.specular));
+        }
+        const SpotLightBlock &spot = lights.spotLight;
+        m_SpotPosition = spot.position;
+        m_SpotDirection = glm::normalize(spot.direction);
+        // nothing shines past the outer cone, not even the ambient term
+        m_SpotCos = spot.outerCutOff;
+        m_SpotSin = std::sqrt(std::max(0.0f, 1.0f - spot.outerCutOff * spot.outerCutOff));
+        m_SpotRange = attenuationRadius(spot.constant, spot.linear, spot.quadratic,
+                                        peak(spot.ambient + spot.diffuse + spot.specular));
+        m_Stats = LightCullingStats();
+    }
+
+    // light list of an object inside the world space box
+    unsigned int lightsFor(const AABB &box) {
+        unsigned int list = 0;
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < NR_POINT_LIGHTS; ++i) {
+            glm::vec3 closest = glm::max(box.min, glm::min(m_PointPositions[i], box.max));
+            glm::vec3 offset = closest - m_PointPositions[i];
+            if (m_PointRadii[i] > 0.0f && glm::dot(offset, offset) <= m_PointRadii[i] * m_PointRadii[i]) {
+                list |= i << (4 + 4 * count);
+                ++count;
+            }
+        }
+        list |= count;
+        // the box's bounding sphere against the cone
+        glm::vec3 center = box.center();
+        float radius = glm::length(box.max - box.min) * 0.5f;
+        if (m_SpotRange > 0.0f && intersectsSpot(center, radius)) {
+            list |= LIGHT_LIST_SPOT;
+            ++count;
+        }
+        ++m_Stats.objects;
+        m_Stats.kept += count;
+        return list;
+    }
+
+    const LightCullingStats &stats() const {
+        return m_Stats;
+    }
+
+private:
+    glm::vec3 m_PointPositions[NR_POINT_LIGHTS];
+    float m_PointRadii[NR_POINT_LIGHTS] = {};
+    glm::vec3 m_SpotPosition;
+    glm::vec3 m_SpotDirection;
+    float m_SpotCos = 1.0f;
+    float m_SpotSin = 0.0f;
+    float m_SpotRange = 0.0f;
+    LightCullingStats m_Stats;
+
+    // brightest channel, every term of the lighting is at most the light's color
+    static float peak(const glm::vec3 &color) {
+        return std::max(color.x, std::max(color.y, color.z));
+    }
+
+    // sphere against a cone capped at the range: outside if the sphere is past the range, behind
+    // the apex, or farther than its radius from the cone's side
+    bool intersectsSpot(const glm::vec3 &center, float radius) const {
+        glm::vec3 offset = center - m_SpotPosition;
+        float along = glm::dot(offset, m_SpotDirection);
+        if (along > m_SpotRange + radius || along < -radius) {
+            return false;
+        }
+        float across = std::sqrt(std::max(0.0f, glm::dot(offset, offset) - along * along));
+        return m_SpotCos * across - m_SpotSin * along <= radius;
+    }
+};
+
+#endif //PROJECT_BASE_LIGHTCULLING_H
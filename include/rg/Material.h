@@ -0,0 +1,63 @@
+#ifndef PROJECT_BASE_MATERIAL_H
+#define PROJECT_BASE_MATERIAL_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader_m.h>
+#include <rg/GLState.h>
+#include <rg/Resources.h>
+#include <string>
+
+// texture slots of a material, each type is always bound to the unit of the same number
+enum TextureType : unsigned int {
+    TEXTURE_DIFFUSE = 0,
+    TEXTURE_SPECULAR = 1,
+    TEXTURE_NORMAL = 2,
+    TEXTURE_HEIGHT = 3,
+    TEXTURE_TYPE_COUNT = 4
+};
+
+// Textures of a surface, resolved once at load time. Because every type has a fixed
+// texture unit, sampler uniforms are set once per program with setSamplers() and
+// drawing with a material is at most one glBindTexture per slot.
+class Material {
+public:
+    // the first texture of a type wins, shaders sample a single texture per type
+    void setTexture(TextureType type, TextureHandle texture) {
+        if (m_Textures[type].isNull()) {
+            m_Textures[type] = texture;
+        }
+    }
+
+    TextureHandle texture(TextureType type) const {
+        return m_Textures[type];
+    }
+
+    // binds every texture the material has to its unit, empty slots are left alone. Like in
+    // RenderQueue, a released texture resolves to 0 and unbinds its unit.
+    void bind() const {
+        ResourcePool<TextureInfo> &textures = Resources::current().textures();
+        for (unsigned int type = 0; type < TEXTURE_TYPE_COUNT; ++type) {
+            if (!m_Textures[type].isNull()) {
+                GLState::current().bindTexture(type, GL_TEXTURE_2D, textures.name(m_Textures[type]));
+            }
+        }
+    }
+
+    // points the program's samplers named prefix + type + suffix (e.g. "material.diffuse"
+    // or "texture_diffuse1") at the matching units. Samplers the program lacks are skipped.
+    static void setSamplers(const Shader &shader, const std::string &prefix, const std::string &suffix = "") {
+        static const char *const typeNames[TEXTURE_TYPE_COUNT] = {"diffuse", "specular", "normal", "height"};
+        shader.use();
+        for (unsigned int type = 0; type < TEXTURE_TYPE_COUNT; ++type) {
+            int location = shader.getUniformLocation(prefix + typeNames[type] + suffix);
+            if (location >= 0) {
+                shader.setInt(location, type);
+            }
+        }
+    }
+
+private:
+    TextureHandle m_Textures[TEXTURE_TYPE_COUNT];
+};
+
+#endif //PROJECT_BASE_MATERIAL_H
@@ -0,0 +1,580 @@
+#ifndef PROJECT_BASE_MULTIDRAWBATCH_H
+#define PROJECT_BASE_MULTIDRAWBATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+#include <rg/Material.h>
+#include <rg/StreamBuffer.h>
+#include <rg/InstanceBuffer.h> // INSTANCE_MODEL_LOCATION, INSTANCE_NORMAL_LOCATION, normalMatrix
+#include <rg/TextureArrayPool.h>
+#include <rg/Frustum.h>
+#include <rg/GLFeatures.h>
+#include <rg/GLState.h>
+#include <rg/HiZBuffer.h>
+#include <rg/LightCulling.h>
+#include <learnopengl/shader_c.h>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand must be tightly packed");
+
+// per-instance attributes after the model matrix (INSTANCE_MODEL_LOCATION 5 to 8) and before the
+// normal matrix (INSTANCE_NORMAL_LOCATION 12 to 14), see object_batch.vs
+#define BATCH_LAYERS_LOCATION 9
+#define BATCH_HANDLES_LOCATION 10
+#define BATCH_LIGHTS_LOCATION 11
+
+// one instance of a batched draw: its transform and where its material's textures live
+struct BatchInstance {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3]; // columns of the model's normal matrix, padded like a std430 mat3
+    GLint layers[2];   // diffuse and specular layer, -1 if the material has no such texture
+    GLuint handles[4]; // bindless handles of the diffuse and specular arrays, low word first
+    GLuint command;    // index of the instance's indirect command, read by cull_batch.comp
+    GLuint lights;     // light list, see LightCuller
+};
+
+static_assert(sizeof(BatchInstance) == 144, "BatchInstance must match the attribute strides");
+
+// Meshes packed into one vertex and one index buffer behind a single VAO, so a frame's
+// draws differ only in offsets. Material textures are copied into a TextureArrayPool and
+// every instance carries its texture layers, so execute() only has to split the indirect
+// commands by the pair of arrays they sample from (texture size), not by material. Each
+// group goes out as one glMultiDrawElementsIndirect; with bindless textures the instances
+// carry the array handles too and everything is a single call.
+// Without multi-draw indirect (a GL 3.3 context) the same commands are issued one by one.
+// Given a frustum, instances whose mesh bounding sphere lies outside it are dropped first.
+// With compute shaders that test can run on the GPU instead (setGpuCulling): cull_batch.comp
+// reads every submitted instance, tests it against the frustum and optionally a HiZBuffer,
+// and appends the survivors to their command's instance range, counting them into the
+// command's instanceCount. The indirect draws then read what it wrote, the CPU never
+// sees the result.
+class MultiDrawBatch {
+public:
+    // queues the material's textures for the pool, returns the id to pass to add()
+    unsigned int addMaterial(const Material &material) {
+        BatchMaterial batchMaterial;
+        // the pool copies the textures once, it keeps the layers even if they are released later
+        ResourcePool<TextureInfo> &textures = Resources::current().textures();
+        batchMaterial.textures[0] = textures.name(material.texture(TEXTURE_DIFFUSE));
+        batchMaterial.textures[1] = textures.name(material.texture(TEXTURE_SPECULAR));
+        for (unsigned int texture : batchMaterial.textures) {
+            m_Pool.add(texture);
+        }
+        m_Materials.push_back(batchMaterial);
+        m_MaterialsResolved = false;
+        return m_Materials.size() - 1;
+    }
+
+    // copies the mesh into the shared buffers, returns the id to pass to add()
+    unsigned int addMesh(const Mesh &mesh) {
+        MeshRange range;
+        range.firstIndex = m_Indices.size();
+        range.count = mesh.indices.size();
+        range.baseVertex = m_Vertices.size();
+        range.sphereCenter = mesh.sphereCenter;
+        range.sphereRadius = mesh.sphereRadius;
+        m_Vertices.insert(m_Vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        m_Indices.insert(m_Indices.end(), mesh.indices.begin(), mesh.indices.end());
+        m_Meshes.push_back(range);
+        m_GeometryDirty = true;
+        return m_Meshes.size() - 1;
+    }
+
+    void begin() {
+        m_Draws.clear();
+        m_Transforms.clear();
+        m_TransformNormals.clear();
+        m_TransformLights.clear();
+        m_Culling = false;
+    }
+
+    // like begin(), and execute() only draws instances that intersect the frustum
+    void begin(const Frustum &frustum) {
+        begin();
+        m_Frustum = frustum;
+        m_Culling = true;
+    }
+
+    // culls in cull_batch.comp instead of on the CPU when the context has compute shaders and
+    // multi-draw indirect, occlusion tests need a built hiZ as well. nullptr returns to CPU culling.
+    void setGpuCulling(const ComputeShader *cullShader, const HiZBuffer *hiZ = nullptr) {
+        if (cullShader && cullShader != m_CullShader) {
+            m_CullUniforms.candidateCount = cullShader->getUniformLocation("candidateCount");
+            m_CullUniforms.frustumPlanes = cullShader->getUniformLocation("frustumPlanes");
+            m_CullUniforms.occlusion = cullShader->getUniformLocation("occlusion");
+            m_CullUniforms.hiZ = cullShader->getUniformLocation("hiZ");
+            m_CullUniforms.hiZViewProjection = cullShader->getUniformLocation("hiZViewProjection");
+            m_CullUniforms.hiZSize = cullShader->getUniformLocation("hiZSize");
+            m_CullUniforms.hiZLevels = cullShader->getUniformLocation("hiZLevels");
+        }
+        m_CullShader = cullShader;
+        m_HiZ = hiZ;
+    }
+
+    // whether the last execute() culled on the GPU
+    bool gpuCulled() const {
+        return m_GpuCulled;
+    }
+
+    // instances used by one or more add() calls, returns the index of the first one.
+    // lights holds one light list per transform, without it every light is applied.
+    // Normal matrices are computed here, once per transform rather than per mesh or per vertex.
+    unsigned int addTransforms(const glm::mat4 *transforms, unsigned int count, const unsigned int *lights = nullptr) {
+        m_Transforms.insert(m_Transforms.end(), transforms, transforms + count);
+        for (unsigned int i = 0; i < count; ++i) {
+            m_TransformNormals.push_back(normalMatrix(transforms[i]));
+        }
+        if (lights) {
+            m_TransformLights.insert(m_TransformLights.end(), lights, lights + count);
+        } else {
+            m_TransformLights.insert(m_TransformLights.end(), count, allLights());
+        }
+        return m_Transforms.size() - count;
+    }
+
+    // draws mesh once per transform in [firstTransform, firstTransform + count) with the material's textures
+    void add(unsigned int mesh, unsigned int material, unsigned int firstTransform, unsigned int count) {
+        if (count == 0) {
+            return;
+        }
+        m_Draws.push_back({mesh, material, firstTransform, count});
+    }
+
+    // the program has to be in use: object_batch.vs with object_batch.fs, whose diffuseArray and
+    // specularArray samplers read units 0 and 1, or object_batch_bindless.fs with bindless textures
+    void execute() {
+        prepare();
+        draw();
+    }
+
+    // culls and uploads the frame's instances and commands, after which draw() can issue them
+    // any number of times, e.g. depth only with depth_prepass.vs and then shaded
+    void prepare() {
+        m_DrawCalls = 0;
+        m_TextureBinds = 0;
+        m_Commands.clear();
+        m_Instances.clear();
+        if (m_Draws.empty()) {
+            return;
+        }
+        uploadGeometry();
+        resolveMaterials();
+
+        GLFeatures &features = GLFeatures::current();
+        bool bindless = features.bindlessTexture;
+        m_GpuCulled = m_Culling && m_CullShader && features.computeShader && features.multiDrawIndirect;
+        if (!bindless) {
+            std::stable_sort(m_Draws.begin(), m_Draws.end(), [this](const Draw &a, const Draw &b) {
+                return arrayKey(a) < arrayKey(b);
+            });
+        }
+        bool cpuCulling = m_Culling && !m_GpuCulled;
+        if (cpuCulling) {
+            cullInstances();
+        }
+        // every command gets its own instances, they differ from other meshes' in the texture layers.
+        // When the GPU culls, these are the candidates and each command reserves room for all of its own.
+        m_CommandSpheres.clear();
+        std::size_t sphere = 0;
+        for (const Draw &draw : m_Draws) {
+            const MeshRange &range = m_Meshes[draw.mesh];
+            const BatchMaterial &material = m_Materials[draw.material];
+            GLuint baseInstance = m_Instances.size();
+            for (unsigned int i = 0; i < draw.instanceCount; ++i) {
+                if (cpuCulling && !m_Culler.visible()[sphere++]) {
+                    continue;
+                }
+                BatchInstance instance = material.instance;
+                instance.model = m_Transforms[draw.firstTransform + i];
+                const glm::mat3 &normal = m_TransformNormals[draw.firstTransform + i];
+                for (int column = 0; column < 3; ++column) {
+                    instance.normalMatrix[column] = glm::vec4(normal[column], 0.0f);
+                }
+                instance.lights = m_TransformLights[draw.firstTransform + i];
+                instance.command = m_Commands.size();
+                m_Instances.push_back(instance);
+            }
+            // fully culled meshes keep their command with no instances, GL skips it
+            GLuint instanceCount = m_GpuCulled ? 0 : (GLuint) m_Instances.size() - baseInstance;
+            m_Commands.push_back({range.count, instanceCount, range.firstIndex, range.baseVertex, baseInstance});
+            if (m_GpuCulled) {
+                m_CommandSpheres.push_back(glm::vec4(range.sphereCenter, range.sphereRadius));
+            }
+        }
+        if (m_Instances.empty()) {
+            return;
+        }
+        if (m_GpuCulled) {
+            cullOnGpu();
+            m_InstanceSource = {m_InstanceBuffer, 0};
+            m_CommandSource = {m_CommandBuffer, 0};
+            setInstanceAttributes(0);
+        } else {
+            StreamBuffer &stream = StreamBuffer::current();
+            StreamRange instances = stream.write(m_Instances.data(), m_Instances.size() * sizeof(BatchInstance));
+            m_InstanceSource = {instances.buffer, instances.offset};
+            // the indirect draws read instances through the VAO, so it follows the stream
+            setInstanceAttributes(0);
+            if (features.multiDrawIndirect) {
+                StreamRange commands = stream.write(m_Commands.data(),
+                                                    m_Commands.size() * sizeof(DrawElementsIndirectCommand));
+                m_CommandSource = {commands.buffer, commands.offset};
+            }
+        }
+    }
+
+    // issues what the last prepare() left, in the program in use. Without textures the groups by
+    // texture array don't matter and everything goes out in as few calls as possible.
+    void draw(bool textures = true) {
+        if (m_Instances.empty()) {
+            return;
+        }
+        GLState &gl = GLState::current();
+        GLFeatures &features = GLFeatures::current();
+        bool bindless = features.bindlessTexture;
+        bool indirect = features.multiDrawIndirect;
+        gl.bindVertexArray(m_VAO);
+        // the furniture isn't wound consistently, and whatever ran before may have left culling on
+        gl.disable(GL_CULL_FACE);
+        if (indirect) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandSource.buffer);
+        }
+        for (std::size_t first = 0, last; first < m_Draws.size(); first = last) {
+            last = first + 1;
+            if (bindless || !textures) {
+                last = m_Draws.size();
+            }
+            while (last < m_Draws.size() && arrayKey(m_Draws[last]) == arrayKey(m_Draws[first])) {
+                ++last;
+            }
+            if (textures && !bindless) {
+                const BatchMaterial &material = m_Materials[m_Draws[first].material];
+                for (unsigned int unit = 0; unit < 2; ++unit) {
+                    if (material.arrays[unit] != 0) {
+                        gl.bindTexture(unit, GL_TEXTURE_2D_ARRAY, material.arrays[unit]);
+                        ++m_TextureBinds;
+                    }
+                }
+            }
+            if (indirect) {
+                GLFeatures::current().multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                                                (void *) (m_CommandSource.offset + first * sizeof(DrawElementsIndirectCommand)),
+                                                                last - first, 0);
+                ++m_DrawCalls;
+            } else {
+                drawOneByOne(first, last);
+            }
+        }
+        if (indirect) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        } else {
+            // leave instance 0 at the start of the buffer
+            setInstanceAttributes(0);
+        }
+    }
+
+    // meshes drawn by the last execute() or prepare()
+    std::size_t commandCount() const {
+        return m_Commands.size();
+    }
+
+    // GL draw calls issued for them since, over every draw()
+    unsigned int drawCallCount() const {
+        return m_DrawCalls;
+    }
+
+    // instances the last execute() tested against its frustum and drew or dropped.
+    // After GPU culling this reads the counts back and waits for the GPU, so it is for statistics only.
+    std::size_t visibleCount() const {
+        if (m_GpuCulled) {
+            return gpuVisibleCount();
+        }
+        return m_Culling ? m_Culler.visibleCount() : m_Instances.size();
+    }
+
+    std::size_t culledCount() const {
+        if (m_GpuCulled) {
+            return m_Instances.size() - gpuVisibleCount();
+        }
+        return m_Culling ? m_Culler.culledCount() : 0;
+    }
+
+    // texture array binds since the last prepare(), bounded by the number of texture sizes
+    unsigned int textureBindCount() const {
+        return m_TextureBinds;
+    }
+
+private:
+    struct MeshRange {
+        GLuint firstIndex;
+        GLuint count;
+        GLint baseVertex;
+        glm::vec3 sphereCenter;
+        float sphereRadius;
+    };
+
+    struct Draw {
+        unsigned int mesh;
+        unsigned int material;
+        unsigned int firstTransform;
+        unsigned int instanceCount;
+    };
+
+    struct BatchMaterial {
+        unsigned int textures[2] = {0, 0}; // diffuse, specular 2D textures
+        unsigned int arrays[2] = {0, 0};   // the pool arrays they were copied to
+        BatchInstance instance = {};       // layers and handles every instance of the material starts from
+    };
+
+    std::vector<Vertex> m_Vertices;
+    std::vector<unsigned int> m_Indices;
+    std::vector<MeshRange> m_Meshes;
+    bool m_GeometryDirty = false;
+
+    std::vector<BatchMaterial> m_Materials;
+    bool m_MaterialsResolved = false;
+    TextureArrayPool m_Pool;
+
+    std::vector<Draw> m_Draws;
+    bool m_Culling = false;
+    Frustum m_Frustum;
+    FrustumCuller m_Culler;
+    std::vector<glm::mat4> m_Transforms;
+    std::vector<glm::mat3> m_TransformNormals;
+    std::vector<unsigned int> m_TransformLights;
+    std::vector<BatchInstance> m_Instances;
+    std::vector<DrawElementsIndirectCommand> m_Commands;
+    std::vector<glm::vec4> m_CommandSpheres; // mesh bounding sphere of every command, for cull_batch.comp
+    const ComputeShader *m_CullShader = nullptr;
+    // locations in m_CullShader, looked up when it is set rather than every dispatch
+    struct CullUniforms {
+        int candidateCount = -1;
+        int frustumPlanes = -1;
+        int occlusion = -1;
+        int hiZ = -1;
+        int hiZViewProjection = -1;
+        int hiZSize = -1;
+        int hiZLevels = -1;
+    } m_CullUniforms;
+    const HiZBuffer *m_HiZ = nullptr;
+    bool m_GpuCulled = false;
+    unsigned int m_DrawCalls = 0;
+    unsigned int m_TextureBinds = 0;
+
+    unsigned int m_VAO = 0;
+    unsigned int m_VBO = 0;
+    unsigned int m_EBO = 0;
+    unsigned int m_CommandBuffer = 0;
+    unsigned int m_InstanceBuffer = 0;
+    std::size_t m_CommandCapacity = 0;
+    std::size_t m_InstanceCapacity = 0;
+
+    // where this frame's instances and commands are read from: the stream buffer, or the buffers cull_batch.comp writes
+    struct BufferSource {
+        unsigned int buffer;
+        std::size_t offset;
+    };
+    BufferSource m_InstanceSource = {0, 0};
+    BufferSource m_CommandSource = {0, 0};
+
+    void uploadGeometry() {
+        if (!m_GeometryDirty) {
+            return;
+        }
+        if (m_VAO == 0) {
+            glGenVertexArrays(1, &m_VAO);
+            glGenBuffers(1, &m_VBO);
+            glGenBuffers(1, &m_EBO);
+            glGenBuffers(1, &m_CommandBuffer);
+            glGenBuffers(1, &m_InstanceBuffer);
+            m_InstanceSource = {m_InstanceBuffer, 0};
+        }
+        GLState::current().bindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), m_Vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(unsigned int), m_Indices.data(), GL_STATIC_DRAW);
+        Mesh::setVertexAttributes();
+        setInstanceAttributes(0);
+        m_GeometryDirty = false;
+    }
+
+    // copies the textures into the pool on first use and looks up every material's layers
+    void resolveMaterials() {
+        if (m_MaterialsResolved) {
+            return;
+        }
+        m_Pool.build();
+        for (BatchMaterial &material : m_Materials) {
+            for (unsigned int slot = 0; slot < 2; ++slot) {
+                TextureLayer location = m_Pool.find(material.textures[slot]);
+                uint64_t handle = m_Pool.handle(location.array);
+                material.arrays[slot] = location.array;
+                material.instance.layers[slot] = location.layer;
+                material.instance.handles[2 * slot] = (GLuint) (handle & 0xFFFFFFFF);
+                material.instance.handles[2 * slot + 1] = (GLuint) (handle >> 32);
+            }
+        }
+        m_MaterialsResolved = true;
+    }
+
+    // world-space bounding sphere of every submitted instance, in draw order, tested in one pass
+    void cullInstances() {
+        m_Culler.clear();
+        for (const Draw &draw : m_Draws) {
+            const MeshRange &range = m_Meshes[draw.mesh];
+            for (unsigned int i = 0; i < draw.instanceCount; ++i) {
+                glm::vec3 center;
+                float radius;
+                transformSphere(m_Transforms[draw.firstTransform + i], range.sphereCenter, range.sphereRadius,
+                                center, radius);
+                m_Culler.add(center, radius);
+            }
+        }
+        m_Culler.cull(m_Frustum);
+    }
+
+    // uploads the candidates and zeroed commands, then lets cull_batch.comp fill the instance buffer and
+    // the instance counts. The barrier makes its writes visible to the indirect draws and attribute fetches.
+    void cullOnGpu() {
+        GLState &gl = GLState::current();
+        GLFeatures &features = GLFeatures::current();
+        // the inputs are only read, so they come straight from the stream buffer
+        StreamBuffer &stream = StreamBuffer::current();
+        std::size_t candidateSize = m_Instances.size() * sizeof(BatchInstance);
+        std::size_t boundsSize = m_CommandSpheres.size() * sizeof(glm::vec4);
+        std::size_t commandSize = m_Commands.size() * sizeof(DrawElementsIndirectCommand);
+        StreamRange candidates = stream.write(m_Instances.data(), candidateSize);
+        StreamRange bounds = stream.write(m_CommandSpheres.data(), boundsSize);
+        StreamRange commands = stream.write(m_Commands.data(), commandSize);
+        // the shader writes the outputs, the zeroed commands are copied in on the GPU so the CPU never
+        // waits for last frame's draws to finish reading them
+        reserveStorage(m_CommandBuffer, commandSize, m_CommandCapacity);
+        reserveStorage(m_InstanceBuffer, candidateSize, m_InstanceCapacity);
+        glBindBuffer(GL_COPY_READ_BUFFER, commands.buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_CommandBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, commands.offset, 0, commandSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, candidates.buffer, candidates.offset, candidateSize);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, bounds.buffer, bounds.offset, boundsSize);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_CommandBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_InstanceBuffer);
+
+        // the draw program is in use, it comes back after the dispatch
+        unsigned int drawProgram = gl.program();
+        const ComputeShader &shader = *m_CullShader;
+        shader.use();
+        const CullUniforms &uniforms = m_CullUniforms;
+        shader.setInt(uniforms.candidateCount, (int) m_Instances.size());
+        shader.setVec4Array(uniforms.frustumPlanes, m_Frustum.planes, 6);
+        bool occlusion = m_HiZ && m_HiZ->isBuilt();
+        shader.setBool(uniforms.occlusion, occlusion);
+        if (occlusion) {
+            gl.bindTexture(HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, m_HiZ->texture());
+            shader.setInt(uniforms.hiZ, HIZ_TEXTURE_UNIT);
+            shader.setMat4(uniforms.hiZViewProjection, m_HiZ->viewProjection());
+            shader.setVec2(uniforms.hiZSize, m_HiZ->size());
+            shader.setInt(uniforms.hiZLevels, m_HiZ->levels());
+        }
+        shader.dispatch((m_Instances.size() + 63) / 64);
+        features.memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        gl.useProgram(drawProgram);
+    }
+
+    // grows a buffer the GPU writes, re-specified only when it has to get bigger
+    static void reserveStorage(unsigned int buffer, std::size_t size, std::size_t &capacity) {
+        if (size <= capacity) {
+            return;
+        }
+        capacity = std::max(size, 2 * capacity);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // sum of the instance counts cull_batch.comp wrote
+    std::size_t gpuVisibleCount() const {
+        std::vector<DrawElementsIndirectCommand> commands(m_Commands.size());
+        if (commands.empty() || m_Instances.empty()) {
+            return 0;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand),
+                           commands.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        std::size_t visible = 0;
+        for (const DrawElementsIndirectCommand &command : commands) {
+            visible += command.instanceCount;
+        }
+        return visible;
+    }
+
+    uint64_t arrayKey(const Draw &draw) const {
+        const BatchMaterial &material = m_Materials[draw.material];
+        return ((uint64_t) material.arrays[0] << 32) | material.arrays[1];
+    }
+
+    // points the per-instance attributes of the VAO at BatchInstance firstInstance onwards
+    void setInstanceAttributes(std::size_t firstInstance) {
+        GLState::current().bindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_InstanceSource.buffer);
+        std::size_t base = m_InstanceSource.offset + firstInstance * sizeof(BatchInstance);
+        for (unsigned int column = 0; column < 4; ++column) {
+            unsigned int location = INSTANCE_MODEL_LOCATION + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(BatchInstance),
+                                  (void *) (base + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        for (unsigned int column = 0; column < 3; ++column) {
+            unsigned int location = INSTANCE_NORMAL_LOCATION + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(BatchInstance),
+                                  (void *) (base + offsetof(BatchInstance, normalMatrix) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        glEnableVertexAttribArray(BATCH_LAYERS_LOCATION);
+        glVertexAttribIPointer(BATCH_LAYERS_LOCATION, 2, GL_INT, sizeof(BatchInstance),
+                               (void *) (base + offsetof(BatchInstance, layers)));
+        glVertexAttribDivisor(BATCH_LAYERS_LOCATION, 1);
+        glEnableVertexAttribArray(BATCH_HANDLES_LOCATION);
+        glVertexAttribIPointer(BATCH_HANDLES_LOCATION, 4, GL_UNSIGNED_INT, sizeof(BatchInstance),
+                               (void *) (base + offsetof(BatchInstance, handles)));
+        glVertexAttribDivisor(BATCH_HANDLES_LOCATION, 1);
+        glEnableVertexAttribArray(BATCH_LIGHTS_LOCATION);
+        glVertexAttribIPointer(BATCH_LIGHTS_LOCATION, 1, GL_UNSIGNED_INT, sizeof(BatchInstance),
+                               (void *) (base + offsetof(BatchInstance, lights)));
+        glVertexAttribDivisor(BATCH_LIGHTS_LOCATION, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // GL 3.3 has no base instance, so the instance attributes are re-pointed for every command
+    void drawOneByOne(std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            const DrawElementsIndirectCommand &command = m_Commands[i];
+            if (command.instanceCount == 0) {
+                continue;
+            }
+            setInstanceAttributes(command.baseInstance);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                                              (void *) (command.firstIndex * sizeof(unsigned int)),
+                                              command.instanceCount, command.baseVertex);
+            ++m_DrawCalls;
+        }
+    }
+};
+
+#endif //PROJECT_BASE_MULTIDRAWBATCH_H
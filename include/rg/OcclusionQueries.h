@@ -0,0 +1,188 @@
+#ifndef PROJECT_BASE_OCCLUSIONQUERIES_H
+#define PROJECT_BASE_OCCLUSIONQUERIES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader_m.h>
+#include <rg/BVH.h> // AABB
+#include <rg/GLState.h>
+#include <rg/GLFeatures.h>
+#include <vector>
+#include <iostream>
+
+enum OcclusionState {
+    OCCLUSION_VISIBLE, // last frame's box passed the depth test, or it was not tested
+    OCCLUSION_HIDDEN,  // last frame's box was completely hidden
+    OCCLUSION_PENDING  // last frame's result hasn't reached the CPU yet
+};
+
+// objects tested by the last begin() and what their results were
+struct OcclusionStats {
+    unsigned int tested = 0;
+    unsigned int hidden = 0;
+    unsigned int pending = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &out, const OcclusionStats &stats) {
+    unsigned int rate = stats.tested ? stats.hidden * 100 / stats.tested : 0;
+    return out << stats.tested << " tested, " << stats.hidden << " hidden (" << rate << "% hit rate), "
+               << stats.pending << " pending under conditional render";
+}
+
+// Hardware occlusion queries over world-space bounding boxes. Each frame issue() draws the
+// queued boxes with color and depth writes off, one query per object, after the occluders
+// are drawn. The next frame's begin() collects whichever results are already available
+// without waiting: objects found hidden can be skipped on the CPU, and objects whose result
+// is still in flight can be drawn under glBeginConditionalRender with conditionQuery(), so
+// the GPU drops them once it knows. Queries alternate between two objects per tracked
+// object, so the one being read is never the one being issued.
+class OcclusionQueries {
+public:
+    // starts tracking an object, returns its id
+    unsigned int add() {
+        m_Objects.push_back(Object());
+        return m_Objects.size() - 1;
+    }
+
+    // picks up last frame's results, call once per frame before the object's draws are submitted
+    void begin() {
+        ++m_Frame;
+        unsigned int previous = (m_Frame + 1) & 1;
+        m_Stats = OcclusionStats();
+        for (Object &object : m_Objects) {
+            object.state = OCCLUSION_VISIBLE;
+            object.conditionQuery = 0;
+            if (!object.issued[previous]) {
+                continue;
+            }
+            ++m_Stats.tested;
+            GLuint query = object.queries[previous];
+            GLuint available = 0;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                object.state = OCCLUSION_PENDING;
+                object.conditionQuery = query;
+                ++m_Stats.pending;
+                continue;
+            }
+            GLuint passed = 0;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT, &passed);
+            object.issued[previous] = false;
+            if (!passed) {
+                object.state = OCCLUSION_HIDDEN;
+                ++m_Stats.hidden;
+            }
+        }
+    }
+
+    OcclusionState state(unsigned int object) const {
+        return m_Objects[object].state;
+    }
+
+    bool hidden(unsigned int object) const {
+        return m_Objects[object].state == OCCLUSION_HIDDEN;
+    }
+
+    // query to condition the object's draws on this frame, 0 when the CPU already knows the result
+    unsigned int conditionQuery(unsigned int object) const {
+        return m_Objects[object].conditionQuery;
+    }
+
+    // tests the object's box in this frame's issue(). Objects not queued count as visible next frame,
+    // so only queue objects that are inside the view frustum.
+    void query(unsigned int object, const AABB &box) {
+        m_Objects[object].box = box;
+        m_Objects[object].queued = true;
+    }
+
+    // draws the queued boxes under their queries, the depth buffer must hold this frame's occluders
+    void issue(const Shader &boxShader, const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition) {
+        GLState &gl = GLState::current();
+        unsigned int current = m_Frame & 1;
+        createBox();
+        boxShader.use();
+        int transformLocation = boxShader.getUniformLocation("transform");
+        gl.bindVertexArray(m_BoxVAO);
+        // the camera may look at the back faces of a box it is close to
+        gl.disable(GL_CULL_FACE);
+        gl.depthMask(false);
+        gl.colorMask(false);
+        GLenum target = GLFeatures::current().atLeast(4, 3) ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+                                                            : GL_ANY_SAMPLES_PASSED;
+        for (Object &object : m_Objects) {
+            object.issued[current] = false;
+            if (!object.queued) {
+                continue;
+            }
+            object.queued = false;
+            // with the camera inside, the near plane clips the box away, so the object must be drawn
+            AABB nearBox = object.box;
+            nearBox.extend(object.box.min - glm::vec3(0.2f));
+            nearBox.extend(object.box.max + glm::vec3(0.2f));
+            if (nearBox.contains(cameraPosition)) {
+                continue;
+            }
+            if (object.queries[0] == 0) {
+                glGenQueries(2, object.queries);
+            }
+            // the object itself is already drawn, its surface must not hide its own box
+            glm::vec3 grow = (object.box.max - object.box.min) * 0.01f + glm::vec3(0.01f);
+            glm::mat4 placement = glm::translate(glm::mat4(1.0f), object.box.min - grow);
+            placement = glm::scale(placement, object.box.max - object.box.min + 2.0f * grow);
+            glm::mat4 transform = viewProjection * placement;
+            glUniformMatrix4fv(transformLocation, 1, GL_FALSE, &transform[0][0]);
+            glBeginQuery(target, object.queries[current]);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glEndQuery(target);
+            object.issued[current] = true;
+        }
+        gl.colorMask(true);
+        gl.depthMask(true);
+    }
+
+    const OcclusionStats &stats() const {
+        return m_Stats;
+    }
+
+private:
+    struct Object {
+        GLuint queries[2] = {0, 0};
+        bool issued[2] = {false, false};
+        AABB box;
+        bool queued = false;
+        OcclusionState state = OCCLUSION_VISIBLE;
+        GLuint conditionQuery = 0;
+    };
+
+    std::vector<Object> m_Objects;
+    unsigned int m_Frame = 0;
+    OcclusionStats m_Stats;
+    unsigned int m_BoxVAO = 0;
+    unsigned int m_BoxVBO = 0;
+
+    // unit cube from (0, 0, 0) to (1, 1, 1), 12 triangles
+    void createBox() {
+        if (m_BoxVAO != 0) {
+            return;
+        }
+        static const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+        std::vector<glm::vec3> vertices;
+        for (const int *face : faces) {
+            const int triangles[6] = {face[0], face[1], face[2], face[0], face[2], face[3]};
+            for (int corner : triangles) {
+                vertices.push_back(glm::vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1));
+            }
+        }
+        glGenVertexArrays(1, &m_BoxVAO);
+        glGenBuffers(1, &m_BoxVBO);
+        GLState::current().bindVertexArray(m_BoxVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_BoxVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *) 0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif //PROJECT_BASE_OCCLUSIONQUERIES_H
@@ -0,0 +1,229 @@
+#ifndef PROJECT_BASE_PROGRAMCACHE_H
+#define PROJECT_BASE_PROGRAMCACHE_H
+
+#include <glad/glad.h>
+#include <rg/GLFeatures.h>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// bumped whenever the cache files change layout, so older ones are compiled again
+#define PROGRAM_CACHE_VERSION 1u
+
+// how the programs created since start were set up
+struct ProgramCacheStats {
+    unsigned int loaded = 0;   // from a cached binary
+    unsigned int compiled = 0; // from source
+    unsigned int stale = 0;    // cached for other sources or another driver, compiled again
+    unsigned int rejected = 0; // cached file damaged or binary the driver refused, compiled again
+    double milliseconds = 0.0; // reading, compiling and linking all of them
+};
+
+inline std::ostream &operator<<(std::ostream &out, const ProgramCacheStats &stats) {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << stats.loaded << " loaded from the cache, " << stats.compiled << " compiled (" << stats.stale << " stale, "
+        << stats.rejected << " rejected) in " << std::fixed << std::setprecision(1) << stats.milliseconds << " ms";
+    out.flags(flags);
+    out.precision(precision);
+    return out;
+}
+
+// Linked programs kept on disk as driver binaries, so later starts skip compiling and linking.
+// A program's file is named after what it is (its paths and defines) and holds the key of what
+// it was built from: a hash of its final sources and the GL vendor, renderer and version strings,
+// which carry the driver version. A file whose key differs, or whose binary the driver turns
+// down, makes the caller compile from source and overwrite it. Without a directory or without
+// GLFeatures::programBinaries every program is compiled as before.
+class ProgramCache {
+public:
+    static ProgramCache &current() {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache& operator=(const ProgramCache&) = delete;
+
+    // an existing directory, empty turns the cache off
+    void setDirectory(const std::string &directory) {
+        m_Directory = directory;
+    }
+
+    bool enabled() const {
+        return !m_Directory.empty() && GLFeatures::current().programBinaries;
+    }
+
+    // identifies the binary built from these sources by this driver
+    uint64_t key(const std::vector<const std::string *> &sources) {
+        if (m_Driver.empty()) {
+            const GLenum names[4] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+            for (GLenum name : names) {
+                const char *value = (const char *) glGetString(name);
+                m_Driver += value ? value : "";
+                m_Driver += '\n';
+            }
+        }
+        const unsigned int version = PROGRAM_CACHE_VERSION;
+        uint64_t value = hash(&version, sizeof(version));
+        value = hash(m_Driver.data(), m_Driver.size(), value);
+        for (const std::string *source : sources) {
+            // the length separates the sources, so moving text between them changes the key
+            uint64_t length = source->size();
+            value = hash(&length, sizeof(length), value);
+            value = hash(source->data(), source->size(), value);
+        }
+        return value;
+    }
+
+    // links program from the binary cached under name if it has the key. On false the program
+    // is untouched as far as the caller is concerned and has to be built from source.
+    bool load(unsigned int program, const std::string &name, uint64_t key) {
+        if (!enabled()) {
+            return false;
+        }
+        std::ifstream file(path(name), std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        // a file cut short or overwritten counts as rejected, like a binary the driver refuses
+        Header header;
+        if (!file.read((char *) &header, sizeof(header)) || std::string(header.magic, 4) != "RGPB") {
+            ++m_Stats.rejected;
+            return false;
+        }
+        if (header.version != PROGRAM_CACHE_VERSION || header.key != key) {
+            ++m_Stats.stale;
+            return false;
+        }
+        std::vector<char> binary(header.length);
+        if (!file.read(binary.data(), binary.size())) {
+            ++m_Stats.rejected;
+            return false;
+        }
+        GLFeatures::current().programBinary(program, header.format, binary.data(), (GLsizei) binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            ++m_Stats.rejected;
+            return false;
+        }
+        ++m_Stats.loaded;
+        return true;
+    }
+
+    // asks the driver to keep the binary of a program about to be linked from source
+    void prepare(unsigned int program) {
+        if (enabled()) {
+            GLFeatures::current().programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+    }
+
+    // stores the binary of a program that linked, a failed write only costs a compile next start
+    void save(unsigned int program, const std::string &name, uint64_t key) {
+        if (!enabled()) {
+            return;
+        }
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+        std::vector<char> binary(length);
+        Header header = {{'R', 'G', 'P', 'B'}, PROGRAM_CACHE_VERSION, 0, 0, key};
+        GLsizei written = 0;
+        GLFeatures::current().getProgramBinary(program, length, &written, &header.format, binary.data());
+        header.length = written;
+        std::ofstream file(path(name), std::ios::binary);
+        file.write((const char *) &header, sizeof(header));
+        file.write(binary.data(), written);
+        if (!file) {
+            std::cout << "WARNING::PROGRAM_CACHE:: Could not write " << path(name) << std::endl;
+        }
+    }
+
+    // one program set up, compiled says whether it came from source
+    void record(double milliseconds, bool compiled) {
+        m_Stats.milliseconds += milliseconds;
+        if (compiled) {
+            ++m_Stats.compiled;
+        }
+    }
+
+    const ProgramCacheStats &stats() const {
+        return m_Stats;
+    }
+
+    // Adds the locations of a linked program's active uniforms by name, the same whether it
+    // was linked from source or from a binary. Arrays are reported once as "name[0]", so the
+    // bare name and every element are registered as well.
+    static void activeUniforms(unsigned int program, std::unordered_map<std::string, int> &locations) {
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        const std::string arraySuffix = "[0]";
+        for (GLint i = 0; i < count; ++i) {
+            GLint size;
+            GLenum type;
+            GLsizei length;
+            glGetActiveUniform(program, (GLuint) i, (GLsizei) buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(program, name.c_str());
+            // members of uniform blocks have no location
+            if (location < 0) {
+                continue;
+            }
+            locations[name] = location;
+            if (name.size() > arraySuffix.size()
+                && name.compare(name.size() - arraySuffix.size(), arraySuffix.size(), arraySuffix) == 0) {
+                std::string base = name.substr(0, name.size() - arraySuffix.size());
+                locations[base] = location;
+                for (GLint element = 1; element < size; ++element) {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    locations[elementName] = glGetUniformLocation(program, elementName.c_str());
+                }
+            }
+        }
+    }
+
+private:
+    struct Header {
+        char magic[4];
+        unsigned int version;
+        GLenum format;
+        unsigned int length;
+        uint64_t key;
+    };
+
+    std::string m_Directory;
+    std::string m_Driver; // vendor, renderer and version strings of the context
+    ProgramCacheStats m_Stats;
+
+    ProgramCache() = default;
+
+    // FNV-1a, continued from value
+    static uint64_t hash(const void *data, std::size_t size, uint64_t value = 14695981039346656037ull) {
+        const unsigned char *bytes = (const unsigned char *) data;
+        for (std::size_t i = 0; i < size; ++i) {
+            value = (value ^ bytes[i]) * 1099511628211ull;
+        }
+        return value;
+    }
+
+    std::string path(const std::string &name) const {
+        std::ostringstream file;
+        file << m_Directory << "/program_" << std::hex << std::setw(16) << std::setfill('0')
+             << hash(name.data(), name.size()) << ".bin";
+        return file.str();
+    }
+};
+
+#endif //PROJECT_BASE_PROGRAMCACHE_H
@@ -0,0 +1,366 @@
+#ifndef PROJECT_BASE_RENDERQUEUE_H
+#define PROJECT_BASE_RENDERQUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GLState.h>
+#include <rg/InstanceBuffer.h>
+#include <rg/Resources.h>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+#define MAX_DRAW_TEXTURES 4
+
+// passes execute in this order, the pass is the most significant part of the sort key
+enum RenderPass : unsigned int {
+    OPAQUE_PASS = 0,
+    TRANSPARENT_PASS = 1
+};
+
+// Everything needed to issue one draw call. Items don't reference each other,
+// so the queue can reorder them freely. Resources are referred to by handle; a draw whose
+// program or vertex array is gone by the time it executes is dropped.
+struct DrawItem {
+    ProgramHandle program;
+    VertexArrayHandle vao;
+    TextureHandle textures[MAX_DRAW_TEXTURES]; // bound to unit i, null leaves the unit alone
+    GLenum mode = GL_TRIANGLES;
+    GLsizei count = 0;
+    GLsizei instanceCount = 1;
+    bool indexed = false;
+    bool cullFace = false;
+    int modelLocation = -1; // if set, the transform at `transform` is uploaded to it before drawing
+    unsigned int transform = 0;
+    int lightsLocation = -1; // if set, `lights` is uploaded to it before drawing
+    unsigned int lights = 0; // light list, see LightCuller
+    unsigned int occlusionQuery = 0; // if set, the draw is conditioned on the query and dropped if it saw nothing
+    StreamRange instances; // if set, the vao's instance attributes are pointed at these InstanceTransforms first
+    bool ownDepth = false; // the fragment shader discards or writes gl_FragDepth, keeps the item out of the depth pre-pass
+};
+
+// GL state transitions needed to execute a frame's draws in a given order
+struct StateChangeStats {
+    unsigned int draws = 0;
+    unsigned int programs = 0;
+    unsigned int vertexArrays = 0;
+    unsigned int textures = 0;
+    unsigned int capabilities = 0;
+    unsigned int stale = 0; // draws dropped because a resource they use was released
+    unsigned int prePassed = 0; // draws shaded against depth laid down by executeDepthPrePass()
+
+    unsigned int total() const {
+        return programs + vertexArrays + textures + capabilities;
+    }
+};
+
+inline std::ostream &operator<<(std::ostream &out, const StateChangeStats &stats) {
+    out << stats.draws << " draws, " << stats.total() << " state changes ("
+        << stats.programs << " programs, " << stats.vertexArrays << " vertex arrays, "
+        << stats.textures << " textures, " << stats.capabilities << " capabilities)";
+    if (stats.prePassed) {
+        out << ", " << stats.prePassed << " after a depth pre-pass";
+    }
+    if (stats.stale) {
+        out << ", " << stats.stale << " stale draws dropped";
+    }
+    return out;
+}
+
+// Collects the draws of a frame, sorts them by a 64-bit key and executes them while
+// skipping state that is already set. Key layout, most significant bits first:
+//   opaque:      pass(4) | program(8) | material(16) | vertex array(16) | depth(20), front to back
+//   transparent: pass(4) | depth(20), back to front | program(8) | material(16) | vertex array(16)
+// Opaque items can first be drawn depth only (executeDepthPrePass); execute() then shades them
+// with GL_EQUAL and depth writes off, so every pixel runs their fragment shader once.
+class RenderQueue {
+public:
+    // starts a new frame, depth is measured along the view direction
+    void begin(const glm::mat4 &view) {
+        m_View = view;
+        m_Items.clear();
+        m_Keys.clear();
+        m_Transforms.clear();
+        m_Sorted = false;
+        m_DepthPrePass = false;
+    }
+
+    unsigned int addTransform(const glm::mat4 &transform) {
+        m_Transforms.push_back(transform);
+        return m_Transforms.size() - 1;
+    }
+
+    // position is the world-space point the draw is ordered by
+    void submit(RenderPass pass, const DrawItem &item, const glm::vec3 &position) {
+        glm::vec4 viewPosition = m_View * glm::vec4(position, 1.0f);
+        uint64_t key = makeKey(pass, item, -viewPosition.z);
+        m_Keys.push_back({key, (uint32_t) m_Items.size()});
+        m_Items.push_back(item);
+        m_Sorted = false;
+    }
+
+    // LSD radix sort over the key bytes, bytes every key shares are skipped
+    void sort() {
+        m_Unsorted = simulate();
+        m_Scratch.resize(m_Keys.size());
+        for (unsigned int shift = 0; shift < 64; shift += 8) {
+            unsigned int histogram[257] = {0};
+            for (const SortEntry &entry : m_Keys) {
+                ++histogram[((entry.key >> shift) & 0xFF) + 1];
+            }
+            if (histogram[((m_Keys.empty() ? 0 : m_Keys[0].key >> shift) & 0xFF) + 1] == m_Keys.size()) {
+                continue;
+            }
+            for (unsigned int digit = 1; digit < 257; ++digit) {
+                histogram[digit] += histogram[digit - 1];
+            }
+            for (const SortEntry &entry : m_Keys) {
+                m_Scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+            }
+            m_Keys.swap(m_Scratch);
+        }
+        m_Sorted = true;
+    }
+
+    void execute() {
+        if (!m_Sorted) {
+            sort();
+        }
+        m_Executed = run();
+        if (m_DepthPrePass) {
+            GLState::current().depthFunc(GL_LESS);
+            GLState::current().depthMask(true);
+        }
+    }
+
+    // Draws the opaque items that don't set ownDepth with program, which has to write depth the
+    // way their own vertex shaders do (depth_prepass.vs) and reads the model matrix from the
+    // instance attributes. Color writes should be off. Items with a model uniform get it as a
+    // constant attribute instead. Call once per frame before execute().
+    void executeDepthPrePass(ProgramHandle program) {
+        m_PrePass = StateChangeStats();
+        GLState &gl = GLState::current();
+        Resources &resources = Resources::current();
+        if (!resources.programs().valid(program)) {
+            return;
+        }
+        // set before sorting, so the submission order stats count the depth state switches too
+        m_DepthPrePass = true;
+        if (!m_Sorted) {
+            sort();
+        }
+        gl.useProgram(resources.programs().name(program));
+        ++m_PrePass.programs;
+        State state;
+        for (const SortEntry &entry : m_Keys) {
+            const DrawItem &item = m_Items[entry.item];
+            if (!prePassed(entry, item)) {
+                continue;
+            }
+            if (!resources.vertexArrays().valid(item.vao)) {
+                ++m_PrePass.stale;
+                continue;
+            }
+            if (state.cullFace != (int) item.cullFace) {
+                state.cullFace = item.cullFace;
+                ++m_PrePass.capabilities;
+                gl.setCapability(GL_CULL_FACE, item.cullFace);
+            }
+            if (state.vao != item.vao) {
+                state.vao = item.vao;
+                state.instances = StreamRange();
+                ++m_PrePass.vertexArrays;
+                gl.bindVertexArray(resources.vertexArrays().name(item.vao));
+            }
+            pointInstances(state, item);
+            if (item.modelLocation >= 0) {
+                const glm::mat4 &model = m_Transforms[item.transform];
+                for (unsigned int column = 0; column < 4; ++column) {
+                    glVertexAttrib4fv(INSTANCE_MODEL_LOCATION + column, &model[column][0]);
+                }
+            }
+            ++m_PrePass.draws;
+            draw(item, true);
+        }
+    }
+
+    // state changes the frame would have needed in submission order
+    const StateChangeStats &unsortedStats() const {
+        return m_Unsorted;
+    }
+
+    // state changes actually issued by the last execute()
+    const StateChangeStats &executedStats() const {
+        return m_Executed;
+    }
+
+    // and by the last executeDepthPrePass()
+    const StateChangeStats &prePassStats() const {
+        return m_PrePass;
+    }
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    glm::mat4 m_View = glm::mat4(1.0f);
+    std::vector<DrawItem> m_Items;
+    std::vector<SortEntry> m_Keys;
+    std::vector<SortEntry> m_Scratch;
+    std::vector<glm::mat4> m_Transforms;
+    bool m_Sorted = false;
+    bool m_DepthPrePass = false; // executeDepthPrePass() ran this frame
+    StateChangeStats m_Unsorted;
+    StateChangeStats m_Executed;
+    StateChangeStats m_PrePass;
+
+    static uint64_t materialKey(const DrawItem &item) {
+        uint64_t hash = 0;
+        for (unsigned int unit = 0; unit < MAX_DRAW_TEXTURES; ++unit) {
+            hash = hash * 31 + item.textures[unit].index();
+        }
+        return hash & 0xFFFF;
+    }
+
+    static uint64_t makeKey(RenderPass pass, const DrawItem &item, float depth) {
+        // 20 bits of depth over the camera's 0.1 - 100 range
+        float normalized = glm::clamp(depth / 100.0f, 0.0f, 1.0f);
+        uint64_t depthBits = (uint64_t) (normalized * 0xFFFFF);
+        // handle indices are dense, so they fit the fields without colliding
+        uint64_t state = ((uint64_t) (item.program.index() & 0xFF) << 32) | (materialKey(item) << 16)
+                         | (item.vao.index() & 0xFFFF);
+        if (pass == TRANSPARENT_PASS) {
+            return ((uint64_t) pass << 60) | ((0xFFFFF - depthBits) << 40) | state;
+        }
+        return ((uint64_t) pass << 60) | (state << 20) | depthBits;
+    }
+
+    // whether the item is drawn by the depth pre-pass, once it ran
+    bool prePassed(const SortEntry &entry, const DrawItem &item) const {
+        return (entry.key >> 60) == OPAQUE_PASS && !item.ownDepth;
+    }
+
+    // counts the transitions of the items in submission order without touching GL, called
+    // before the keys are sorted
+    StateChangeStats simulate() {
+        StateChangeStats stats;
+        State state;
+        for (const SortEntry &entry : m_Keys) {
+            apply(state, entry, stats, false);
+        }
+        return stats;
+    }
+
+    StateChangeStats run() {
+        StateChangeStats stats;
+        State state;
+        for (const SortEntry &entry : m_Keys) {
+            apply(state, entry, stats, true);
+        }
+        return stats;
+    }
+
+    // state as the queue last left it, null handles mean unknown
+    struct State {
+        ProgramHandle program;
+        VertexArrayHandle vao;
+        TextureHandle textures[MAX_DRAW_TEXTURES];
+        StreamRange instances; // what the bound vao's instance attributes point at
+        int cullFace = -1;
+        int depthEqual = -1;
+    };
+
+    // the calls go through GLState, which may still drop some if the frame starts in a matching state
+    void apply(State &state, const SortEntry &entry, StateChangeStats &stats, bool issueCalls) {
+        const DrawItem &item = m_Items[entry.item];
+        GLState &gl = GLState::current();
+        Resources &resources = Resources::current();
+        if (!resources.programs().valid(item.program) || !resources.vertexArrays().valid(item.vao)) {
+            ++stats.stale;
+            return;
+        }
+        if (state.program != item.program) {
+            state.program = item.program;
+            ++stats.programs;
+            if (issueCalls) gl.useProgram(resources.programs().name(item.program));
+        }
+        if (state.cullFace != (int) item.cullFace) {
+            state.cullFace = item.cullFace;
+            ++stats.capabilities;
+            if (issueCalls) gl.setCapability(GL_CULL_FACE, item.cullFace);
+        }
+        // depth of pre-passed items is already there, they only shade the pixels that kept it
+        bool depthEqual = m_DepthPrePass && prePassed(entry, item);
+        if (state.depthEqual != (int) depthEqual) {
+            state.depthEqual = depthEqual;
+            ++stats.capabilities;
+            if (issueCalls) {
+                gl.depthFunc(depthEqual ? GL_EQUAL : GL_LESS);
+                gl.depthMask(!depthEqual);
+            }
+        }
+        if (depthEqual) {
+            ++stats.prePassed;
+        }
+        for (unsigned int unit = 0; unit < MAX_DRAW_TEXTURES; ++unit) {
+            TextureHandle texture = item.textures[unit];
+            if (!texture.isNull() && state.textures[unit] != texture) {
+                state.textures[unit] = texture;
+                ++stats.textures;
+                // a released texture resolves to 0, which unbinds the unit instead of reaching a recycled name
+                if (issueCalls) gl.bindTexture(unit, GL_TEXTURE_2D, resources.textures().name(texture));
+            }
+        }
+        if (state.vao != item.vao) {
+            state.vao = item.vao;
+            state.instances = StreamRange();
+            ++stats.vertexArrays;
+            if (issueCalls) gl.bindVertexArray(resources.vertexArrays().name(item.vao));
+        }
+        ++stats.draws;
+        if (!issueCalls) {
+            return;
+        }
+        pointInstances(state, item);
+        if (item.modelLocation >= 0) {
+            glUniformMatrix4fv(item.modelLocation, 1, GL_FALSE, &m_Transforms[item.transform][0][0]);
+        }
+        if (item.lightsLocation >= 0) {
+            glUniform1ui(item.lightsLocation, item.lights);
+        }
+        // the query's result may arrive between the passes, so only the pre-pass is conditioned on
+        // it; where that skipped the item its depth is missing and GL_EQUAL drops it just the same
+        draw(item, !depthEqual);
+    }
+
+    // Several items of a frame may draw one vao with instances of their own, and the vao's
+    // attributes stay where the previous one left them, so each item points them at its range.
+    static void pointInstances(State &state, const DrawItem &item) {
+        if (item.instances.buffer == 0 || (state.instances.buffer == item.instances.buffer
+                                           && state.instances.offset == item.instances.offset)) {
+            return;
+        }
+        state.instances = item.instances;
+        InstanceBuffer::setInstanceAttributes(Resources::current().vertexArrays().name(item.vao), item.instances);
+    }
+
+    static void draw(const DrawItem &item, bool conditional) {
+        bool condition = conditional && item.occlusionQuery != 0;
+        // GL_QUERY_NO_WAIT draws anyway while the query is still in flight, it never stalls
+        if (condition) {
+            glBeginConditionalRender(item.occlusionQuery, GL_QUERY_NO_WAIT);
+        }
+        if (item.indexed) {
+            glDrawElementsInstanced(item.mode, item.count, GL_UNSIGNED_INT, 0, item.instanceCount);
+        } else {
+            glDrawArraysInstanced(item.mode, 0, item.count, item.instanceCount);
+        }
+        if (condition) {
+            glEndConditionalRender();
+        }
+    }
+};
+
+#endif //PROJECT_BASE_RENDERQUEUE_H
@@ -0,0 +1,233 @@
+#ifndef PROJECT_BASE_RESOURCES_H
+#define PROJECT_BASE_RESOURCES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// low bits of a handle index its pool's slot, the high bits hold the slot's generation
+#define HANDLE_INDEX_BITS 20
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK ((1u << (32 - HANDLE_INDEX_BITS)) - 1)
+
+// Reference to a slot of a ResourcePool<Info>, 32 bits: the slot's index and the generation
+// the slot had when the handle was made. Releasing a slot bumps its generation,
+// so older handles stop resolving instead of reaching whatever reuses the slot or the GL name.
+// Generations start at 1, the zero handle is null.
+template <typename Info>
+class Handle {
+public:
+    Handle() = default;
+
+    static Handle make(unsigned int index, unsigned int generation) {
+        Handle handle;
+        handle.m_Value = (generation << HANDLE_INDEX_BITS) | (index & HANDLE_INDEX_MASK);
+        return handle;
+    }
+
+    bool isNull() const {
+        return m_Value == 0;
+    }
+
+    unsigned int index() const {
+        return m_Value & HANDLE_INDEX_MASK;
+    }
+
+    unsigned int generation() const {
+        return m_Value >> HANDLE_INDEX_BITS;
+    }
+
+    uint32_t value() const {
+        return m_Value;
+    }
+
+    bool operator==(Handle other) const {
+        return m_Value == other.m_Value;
+    }
+
+    bool operator!=(Handle other) const {
+        return m_Value != other.m_Value;
+    }
+
+private:
+    uint32_t m_Value = 0;
+};
+
+// GL objects of one kind behind generational handles. GL names, generations and the
+// per-object Info sit in parallel arrays indexed by slot; released slots are reused, so a
+// reload is a release() and an add() that takes the same slot under a new generation.
+// A lookup through a stale handle costs one compare and yields 0.
+template <typename Info>
+class ResourcePool {
+public:
+    // a null handle once every index a handle can hold is taken, the name stays the caller's
+    Handle<Info> add(unsigned int name, const Info &info = Info()) {
+        unsigned int index;
+        if (!m_Free.empty()) {
+            index = m_Free.back();
+            m_Free.pop_back();
+        } else {
+            // a larger index would be masked into slot 0's handles
+            if (m_Names.size() > HANDLE_INDEX_MASK) {
+                std::cout << "ERROR::RESOURCES:: pool full, " << m_Names.size() << " objects alive" << std::endl;
+                return Handle<Info>();
+            }
+            index = m_Names.size();
+            m_Names.push_back(0);
+            m_Generations.push_back(1);
+            m_Infos.push_back(Info());
+        }
+        m_Names[index] = name;
+        m_Infos[index] = info;
+        return Handle<Info>::make(index, m_Generations[index]);
+    }
+
+    // Makes the handle and every copy of it stale and frees the slot. Returns the GL name for
+    // the caller to delete, 0 if the handle was stale already.
+    unsigned int release(Handle<Info> handle) {
+        if (!valid(handle)) {
+            return 0;
+        }
+        unsigned int index = handle.index();
+        unsigned int name = m_Names[index];
+        m_Names[index] = 0;
+        bumpGeneration(index);
+        m_Free.push_back(index);
+        return name;
+    }
+
+    bool valid(Handle<Info> handle) const {
+        return !handle.isNull() && handle.index() < m_Names.size()
+               && m_Generations[handle.index()] == handle.generation();
+    }
+
+    // the GL name behind the handle, 0 if the handle is null or stale
+    unsigned int name(Handle<Info> handle) const {
+        return valid(handle) ? m_Names[handle.index()] : 0;
+    }
+
+    // only for valid handles
+    const Info &info(Handle<Info> handle) const {
+        return m_Infos[handle.index()];
+    }
+
+    // objects alive
+    std::size_t size() const {
+        return m_Names.size() - m_Free.size();
+    }
+
+private:
+    std::vector<unsigned int> m_Names;
+    std::vector<unsigned int> m_Generations;
+    std::vector<Info> m_Infos;
+    std::vector<unsigned int> m_Free;
+
+    void bumpGeneration(unsigned int index) {
+        unsigned int generation = (m_Generations[index] + 1) & HANDLE_GENERATION_MASK;
+        m_Generations[index] = generation == 0 ? 1 : generation;
+    }
+};
+
+// Every distinct string stored once; the rest of the code passes its small integer id.
+class StringTable {
+public:
+    unsigned int intern(const std::string &string) {
+        std::unordered_map<std::string, unsigned int>::const_iterator it = m_Ids.find(string);
+        if (it != m_Ids.end()) {
+            return it->second;
+        }
+        m_Strings.push_back(string);
+        m_Ids.emplace(string, m_Strings.size() - 1);
+        return m_Strings.size() - 1;
+    }
+
+    const std::string &str(unsigned int id) const {
+        return m_Strings[id];
+    }
+
+private:
+    std::vector<std::string> m_Strings;
+    std::unordered_map<std::string, unsigned int> m_Ids;
+};
+
+struct TextureInfo {
+    unsigned int path = ~0u; // interned file path, ~0u for textures not loaded from a file
+};
+
+struct VertexArrayInfo {
+    unsigned int count = 0; // vertices or indices a draw of the whole array reads
+};
+
+struct ProgramInfo {
+    unsigned int vertexPath = 0;   // interned shader file paths
+    unsigned int fragmentPath = 0;
+    unsigned int defines = 0;      // interned #define lines both stages were compiled with
+};
+
+typedef Handle<TextureInfo> TextureHandle;
+typedef Handle<VertexArrayInfo> VertexArrayHandle;
+typedef Handle<ProgramInfo> ProgramHandle;
+
+// The textures, vertex arrays and programs that draws refer to, and the strings naming them.
+// Draw items carry handles instead of GL names: they are dense, so sort keys built from them
+// don't collide, and a draw whose resource was released or reloaded is caught by one compare.
+class Resources {
+public:
+    static Resources &current() {
+        static Resources resources;
+        return resources;
+    }
+
+    Resources(const Resources&) = delete;
+    Resources& operator=(const Resources&) = delete;
+
+    ResourcePool<TextureInfo> &textures() {
+        return m_Textures;
+    }
+
+    ResourcePool<VertexArrayInfo> &vertexArrays() {
+        return m_VertexArrays;
+    }
+
+    ResourcePool<ProgramInfo> &programs() {
+        return m_Programs;
+    }
+
+    StringTable &strings() {
+        return m_Strings;
+    }
+
+    TextureHandle addTexture(unsigned int name, const std::string &path) {
+        TextureInfo info;
+        info.path = m_Strings.intern(path);
+        TextureHandle handle = m_Textures.add(name, info);
+        if (info.path >= m_TexturesByPath.size()) {
+            m_TexturesByPath.resize(info.path + 1);
+        }
+        m_TexturesByPath[info.path] = handle;
+        return handle;
+    }
+
+    // the texture last added from the path, null if there is none or it was released since
+    TextureHandle findTexture(const std::string &path) {
+        unsigned int id = m_Strings.intern(path);
+        if (id < m_TexturesByPath.size() && m_Textures.valid(m_TexturesByPath[id])) {
+            return m_TexturesByPath[id];
+        }
+        return TextureHandle();
+    }
+
+private:
+    ResourcePool<TextureInfo> m_Textures;
+    ResourcePool<VertexArrayInfo> m_VertexArrays;
+    ResourcePool<ProgramInfo> m_Programs;
+    StringTable m_Strings;
+    std::vector<TextureHandle> m_TexturesByPath; // indexed by interned path
+
+    Resources() = default;
+};
+
+#endif //PROJECT_BASE_RESOURCES_H
@@ -0,0 +1,299 @@
+#ifndef PROJECT_BASE_SCENEGRAPH_H
+#define PROJECT_BASE_SCENEGRAPH_H
+
+#include <glm/glm.hpp>
+#include <rg/BVH.h>
+#include <rg/Frustum.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+const unsigned int SCENE_NO_PARENT = ~0u;
+
+// Hierarchy of transforms. A node's world matrix is its parent's world times its local
+// matrix. Nodes are stored as parallel arrays, one per field, so update() walks tightly
+// packed matrices. setLocal() marks a node dirty, update() marks its descendants too and
+// recomputes only those, level by level from the roots down: every matrix of a level only
+// needs the level above, so a level is one batch for the SIMD matrix product. A static scene
+// costs nothing per frame.
+// Nodes with bounds are kept in a BVH: moved nodes are refitted, and the tree is rebuilt
+// when nodes are added or refitting has let the root grow to twice its built area.
+// Parents must be added before their children.
+class SceneGraph {
+public:
+    unsigned int addNode(const std::string &name, unsigned int parent = SCENE_NO_PARENT,
+                         const glm::mat4 &local = glm::mat4(1.0f)) {
+        unsigned int node = m_Local.size();
+        m_Names.push_back(name);
+        m_Parents.push_back(parent);
+        m_Depths.push_back(parent == SCENE_NO_PARENT ? 0 : m_Depths[parent] + 1);
+        m_FirstChild.push_back(SCENE_NO_PARENT);
+        m_NextSibling.push_back(SCENE_NO_PARENT);
+        if (parent != SCENE_NO_PARENT) {
+            m_NextSibling[node] = m_FirstChild[parent];
+            m_FirstChild[parent] = node;
+        }
+        m_Local.push_back(local);
+        m_World.push_back(local);
+        m_HasBounds.push_back(0);
+        m_Bounds.push_back(AABB());
+        m_WorldBounds.push_back(AABB());
+        m_Dirty.push_back(0);
+        m_Visible.push_back(1);
+        markDirty(node);
+        m_Rebuild = true;
+        return node;
+    }
+
+    void setLocal(unsigned int node, const glm::mat4 &local) {
+        m_Local[node] = local;
+        markDirty(node);
+    }
+
+    void setBounds(unsigned int node, const AABB &bounds) {
+        m_Bounds[node] = bounds;
+        m_HasBounds[node] = 1;
+        markDirty(node);
+        m_Rebuild = true;
+    }
+
+    void update() {
+        m_Moved.clear();
+        for (std::vector<unsigned int> &level : m_Levels) {
+            level.clear();
+        }
+        // a dirty node's subtree is collected once, whichever of its dirty nodes comes first
+        for (unsigned int node : m_DirtyRoots) {
+            collect(node);
+        }
+        m_DirtyRoots.clear();
+
+        for (const std::vector<unsigned int> &level : m_Levels) {
+            composeWorld(level.data(), level.size());
+            for (unsigned int i : level) {
+                m_Dirty[i] = 0;
+                if (m_HasBounds[i]) {
+                    m_WorldBounds[i] = m_Bounds[i].transformed(m_World[i]);
+                    m_Moved.push_back(i);
+                }
+            }
+        }
+
+        if (!m_Rebuild) {
+            for (unsigned int i : m_Moved) {
+                m_BVH.refit(i, m_WorldBounds[i]);
+            }
+        }
+        if (m_Rebuild || m_BVH.rootArea() > 2.0f * m_BuiltArea) {
+            rebuild();
+        }
+    }
+
+    // marks the nodes whose bounds intersect the frustum, nodes without bounds are always visible
+    void cull(const Frustum &frustum) {
+        for (unsigned int i = 0; i < m_Visible.size(); ++i) {
+            m_Visible[i] = !m_HasBounds[i];
+        }
+        m_Query.clear();
+        m_BVH.queryFrustum(frustum, m_Query);
+        for (unsigned int i : m_Query) {
+            m_Visible[i] = 1;
+        }
+        m_VisibleCount = m_Query.size();
+    }
+
+    // drops a node that passed cull() but turned out to be hidden, e.g. behind other objects
+    void hide(unsigned int node) {
+        if (m_Visible[node] && m_HasBounds[node]) {
+            m_Visible[node] = 0;
+            --m_VisibleCount;
+        }
+    }
+
+    // nearest node whose world bounds the ray hits
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, unsigned int &node, float &distance) const {
+        return m_BVH.raycast(origin, direction, node, distance);
+    }
+
+    bool visible(unsigned int node) const {
+        return m_Visible[node] != 0;
+    }
+
+    const glm::mat4 &world(unsigned int node) const {
+        return m_World[node];
+    }
+
+    const std::string &name(unsigned int node) const {
+        return m_Names[node];
+    }
+
+    unsigned int parent(unsigned int node) const {
+        return m_Parents[node];
+    }
+
+    bool hasBounds(unsigned int node) const {
+        return m_HasBounds[node] != 0;
+    }
+
+    // valid after update() when hasBounds() is set
+    const AABB &worldBounds(unsigned int node) const {
+        return m_WorldBounds[node];
+    }
+
+    std::size_t size() const {
+        return m_Local.size();
+    }
+
+    // bounded nodes that passed the last cull()
+    std::size_t visibleCount() const {
+        return m_VisibleCount;
+    }
+
+    std::size_t bvhNodeCount() const {
+        return m_BVH.nodeCount();
+    }
+
+    // nodes whose world matrix the last update() recomputed
+    std::size_t updatedCount() const {
+        std::size_t count = 0;
+        for (const std::vector<unsigned int> &level : m_Levels) {
+            count += level.size();
+        }
+        return count;
+    }
+
+private:
+    std::vector<std::string> m_Names;
+    std::vector<unsigned int> m_Parents;
+    std::vector<unsigned int> m_Depths;      // 0 for roots
+    std::vector<unsigned int> m_FirstChild;
+    std::vector<unsigned int> m_NextSibling;
+    std::vector<glm::mat4> m_Local;
+    std::vector<glm::mat4> m_World;
+    std::vector<uint8_t> m_HasBounds;
+    std::vector<AABB> m_Bounds;              // in the node's own space
+    std::vector<AABB> m_WorldBounds;
+    std::vector<uint8_t> m_Dirty;            // 1 once marked, 2 once filed under m_Levels by update()
+    std::vector<uint8_t> m_Visible;
+    std::vector<unsigned int> m_DirtyRoots;  // nodes setLocal() or setBounds() changed since the last update()
+    std::vector<std::vector<unsigned int>> m_Levels; // dirty nodes by depth
+    std::vector<unsigned int> m_Stack;
+    std::vector<unsigned int> m_Moved;
+    std::vector<unsigned int> m_Query;
+    std::size_t m_VisibleCount = 0;
+    BVH m_BVH;
+    float m_BuiltArea = 0.0f;
+    bool m_Rebuild = true;
+
+    void markDirty(unsigned int node) {
+        if (!m_Dirty[node]) {
+            m_Dirty[node] = 1;
+            m_DirtyRoots.push_back(node);
+        }
+    }
+
+    // files the node and its whole subtree under their levels, skipping subtrees filed before
+    void collect(unsigned int node) {
+        if (m_Dirty[node] == 2) {
+            return;
+        }
+        m_Stack.clear();
+        m_Stack.push_back(node);
+        while (!m_Stack.empty()) {
+            unsigned int current = m_Stack.back();
+            m_Stack.pop_back();
+            m_Dirty[current] = 2;
+            unsigned int depth = m_Depths[current];
+            if (depth >= m_Levels.size()) {
+                m_Levels.resize(depth + 1);
+            }
+            m_Levels[depth].push_back(current);
+            for (unsigned int child = m_FirstChild[current]; child != SCENE_NO_PARENT; child = m_NextSibling[child]) {
+                if (m_Dirty[child] != 2) {
+                    m_Stack.push_back(child);
+                }
+            }
+        }
+    }
+
+    // world = parent's world * local for a batch of nodes of one level
+    void composeWorld(const unsigned int *nodes, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            unsigned int node = nodes[i];
+            unsigned int parent = m_Parents[node];
+            if (parent == SCENE_NO_PARENT) {
+                m_World[node] = m_Local[node];
+            } else {
+                multiply(&m_World[parent][0][0], &m_Local[node][0][0], &m_World[node][0][0]);
+            }
+        }
+    }
+
+    // out = a * b for column-major 4x4 matrices: column c of out is a's columns weighted by b's column c
+    static void multiply(const float *a, const float *b, float *out) {
+#if defined(__AVX__)
+        // two output columns per register, a's columns repeated in both halves
+        __m256 a0 = _mm256_broadcast_ps((const __m128 *) (a + 0));
+        __m256 a1 = _mm256_broadcast_ps((const __m128 *) (a + 4));
+        __m256 a2 = _mm256_broadcast_ps((const __m128 *) (a + 8));
+        __m256 a3 = _mm256_broadcast_ps((const __m128 *) (a + 12));
+        for (int c = 0; c < 4; c += 2) {
+            const float *b0 = b + 4 * c;
+            const float *b1 = b0 + 4;
+            __m256 column = _mm256_mul_ps(a0, pair(b0[0], b1[0]));
+            column = _mm256_add_ps(column, _mm256_mul_ps(a1, pair(b0[1], b1[1])));
+            column = _mm256_add_ps(column, _mm256_mul_ps(a2, pair(b0[2], b1[2])));
+            column = _mm256_add_ps(column, _mm256_mul_ps(a3, pair(b0[3], b1[3])));
+            _mm256_storeu_ps(out + 4 * c, column);
+        }
+#elif defined(__SSE__) || defined(_M_X64)
+        __m128 a0 = _mm_loadu_ps(a + 0);
+        __m128 a1 = _mm_loadu_ps(a + 4);
+        __m128 a2 = _mm_loadu_ps(a + 8);
+        __m128 a3 = _mm_loadu_ps(a + 12);
+        for (int c = 0; c < 4; ++c) {
+            const float *column = b + 4 * c;
+            __m128 result = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+            result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+            result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+            result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+            _mm_storeu_ps(out + 4 * c, result);
+        }
+#else
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) {
+                out[4 * c + r] = a[r] * b[4 * c] + a[4 + r] * b[4 * c + 1] + a[8 + r] * b[4 * c + 2]
+                                 + a[12 + r] * b[4 * c + 3];
+            }
+        }
+#endif
+    }
+
+#if defined(__AVX__)
+    // x in the low half, y in the high half
+    static __m256 pair(float x, float y) {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(x)), _mm_set1_ps(y), 1);
+    }
+#endif
+
+    void rebuild() {
+        std::vector<unsigned int> items;
+        std::vector<AABB> boxes;
+        for (unsigned int i = 0; i < m_Local.size(); ++i) {
+            if (m_HasBounds[i]) {
+                items.push_back(i);
+                boxes.push_back(m_WorldBounds[i]);
+            }
+        }
+        m_BVH.build(items, boxes);
+        m_BuiltArea = m_BVH.rootArea();
+        m_Rebuild = false;
+    }
+};
+
+#endif //PROJECT_BASE_SCENEGRAPH_H
@@ -6,15 +6,21 @@
 #define PROJECT_BASE_SHADER_H
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <glad/glad.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <rg/Error.h>
+#include <rg/GLState.h>
+#include <rg/ProgramCache.h>
 #include <common.h>
 #include <glm/glm.hpp>
 class Shader {
     unsigned int m_Id;
+    std::unordered_map<std::string, int> uniformLocations;
+
 public:
     Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
         appendShaderFolderIfNotPresent(vertexShaderPath);
@@ -65,75 +71,134 @@ public:
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
         m_Id = shaderProgram;
+        ProgramCache::activeUniforms(m_Id, uniformLocations);
     }
 
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
-        glUseProgram(m_Id);
+        GLState::current().useProgram(m_Id);
+    }
+    // returns the location of an active uniform, resolved once at link time (-1 if it is not active).
+    // hot paths should look the location up once and use the location overloads below.
+    // ------------------------------------------------------------------------
+    int getUniformLocation(const std::string &name) const
+    {
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
+    {         
+        setBool(getUniformLocation(name), value);
+    }
+    void setBool(int location, bool value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        glUniform1i(location, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
+    { 
+        setInt(getUniformLocation(name), value);
+    }
+    void setInt(int location, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        glUniform1i(location, value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
+    { 
+        setFloat(getUniformLocation(name), value);
+    }
+    void setFloat(int location, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        glUniform1f(location, value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
+    { 
+        setVec2(getUniformLocation(name), value);
+    }
+    void setVec2(int location, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform2fv(location, 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
+    { 
+        setVec2(getUniformLocation(name), x, y);
+    }
+    void setVec2(int location, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        glUniform2f(location, x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
+    { 
+        setVec3(getUniformLocation(name), value);
+    }
+    void setVec3(int location, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform3fv(location, 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
+    { 
+        setVec3(getUniformLocation(name), x, y, z);
+    }
+    void setVec3(int location, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        glUniform3f(location, x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
+    { 
+        setVec4(getUniformLocation(name), value);
+    }
+    void setVec4(int location, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform4fv(location, 1, &value[0]);
+    }
+    void setVec4(const std::string &name, float x, float y, float z, float w) const
+    { 
+        setVec4(getUniformLocation(name), x, y, z, w);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w)
+    void setVec4(int location, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        glUniform4f(location, x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(getUniformLocation(name), mat);
+    }
+    void setMat2(int location, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(getUniformLocation(name), mat);
+    }
+    void setMat3(int location, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(getUniformLocation(name), mat);
     }
+    void setMat4(int location, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+
     void deleteProgram() {
         glDeleteProgram(m_Id);
         m_Id = 0;
+        uniformLocations.clear();
     }
 
 
@@ -0,0 +1,93 @@
+#ifndef PROJECT_BASE_SHADERVARIANTS_H
+#define PROJECT_BASE_SHADERVARIANTS_H
+
+#include <learnopengl/shader_m.h>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// a variant's features, bit i stands for the i-th feature name
+#define SHADER_MAX_FEATURES 8
+
+// Permutations of one vertex/fragment pair. Each feature is a #define the sources test with
+// #ifdef, so a variant only contains the code of the features it was compiled with instead of
+// branching on uniforms at run time. Variants are keyed by their feature bitmask, compiled the
+// first time variant() asks for them (or ahead of that by prewarm()) and kept for good, so a
+// feature switched back on costs nothing. Every variant is a program of its own with its own
+// uniform locations; setup() runs once on each right after it is linked, for samplers and
+// uniform blocks. Compiling needs the GL context, so variant() belongs on the thread that draws.
+class ShaderVariants {
+public:
+    // common are #define lines every variant gets, e.g. constants shared with C++
+    ShaderVariants(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &features,
+                   const std::string &common = "")
+            : m_VertexPath(vertexPath), m_FragmentPath(fragmentPath), m_Features(features), m_Common(common) {
+        if (m_Features.size() > SHADER_MAX_FEATURES) {
+            std::cout << "ERROR::SHADER_VARIANTS:: " << m_FragmentPath << " has more than " << SHADER_MAX_FEATURES
+                      << " features, the rest are ignored" << std::endl;
+            m_Features.resize(SHADER_MAX_FEATURES);
+        }
+        m_Variants.resize((std::size_t) 1 << m_Features.size());
+    }
+
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    void setup(std::function<void(Shader &)> setup) {
+        m_Setup = setup;
+    }
+
+    // the program for exactly these features, bits of no feature are ignored
+    Shader &variant(unsigned int features) {
+        features &= m_Variants.size() - 1;
+        std::unique_ptr<Shader> &variant = m_Variants[features];
+        if (!variant) {
+            variant.reset(new Shader(m_VertexPath.c_str(), m_FragmentPath.c_str(), defines(features)));
+            if (m_Setup) {
+                m_Setup(*variant);
+            }
+            ++m_Compiled;
+        }
+        return *variant;
+    }
+
+    // compiles the variants up front, so switching to them later doesn't stall a frame
+    void prewarm(const std::vector<unsigned int> &variants) {
+        for (unsigned int features : variants) {
+            variant(features);
+        }
+    }
+
+    // variants compiled so far, out of 2^features possible
+    unsigned int compiledCount() const {
+        return m_Compiled;
+    }
+
+    std::size_t variantCount() const {
+        return m_Variants.size();
+    }
+
+    // the #define block of a variant
+    std::string defines(unsigned int features) const {
+        std::string block = m_Common;
+        for (std::size_t bit = 0; bit < m_Features.size(); ++bit) {
+            if (features & (1u << bit)) {
+                block += "#define " + m_Features[bit] + "\n";
+            }
+        }
+        return block;
+    }
+
+private:
+    std::string m_VertexPath;
+    std::string m_FragmentPath;
+    std::vector<std::string> m_Features;
+    std::string m_Common;
+    std::vector<std::unique_ptr<Shader>> m_Variants; // indexed by feature mask
+    std::function<void(Shader &)> m_Setup;
+    unsigned int m_Compiled = 0;
+};
+
+#endif //PROJECT_BASE_SHADERVARIANTS_H
@@ -0,0 +1,440 @@
+#ifndef PROJECT_BASE_SOFTWAREOCCLUSION_H
+#define PROJECT_BASE_SOFTWAREOCCLUSION_H
+
+#include <glm/glm.hpp>
+#include <rg/BVH.h> // AABB
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// Triangles that only stand in for a mesh in the occlusion buffer, in the mesh's own space.
+// They must lie inside the real mesh, or objects behind the gaps would be hidden.
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+
+    // the box's 12 triangles
+    static OccluderMesh box(const AABB &box) {
+        static const unsigned int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+        OccluderMesh mesh;
+        for (int corner = 0; corner < 8; ++corner) {
+            mesh.positions.push_back(glm::vec3((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y,
+                                               (corner & 4) ? box.max.z : box.min.z));
+        }
+        for (const unsigned int *face : faces) {
+            const unsigned int triangles[6] = {face[0], face[1], face[2], face[0], face[2], face[3]};
+            mesh.indices.insert(mesh.indices.end(), triangles, triangles + 6);
+        }
+        return mesh;
+    }
+};
+
+// occluders drawn and objects tested since the last begin()
+struct SoftwareOcclusionStats {
+    unsigned int occluderTriangles = 0;
+    unsigned int tested = 0;
+    unsigned int hidden = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &out, const SoftwareOcclusionStats &stats) {
+    unsigned int rate = stats.tested ? stats.hidden * 100 / stats.tested : 0;
+    return out << stats.occluderTriangles << " occluder triangles, " << stats.tested << " tested, "
+               << stats.hidden << " hidden (" << rate << "% hit rate)";
+}
+
+// Occlusion culling on the CPU, without a round trip to the GPU. A few large occluders are
+// rasterized at low resolution into a depth buffer, then every object's box is tested
+// against it before its draws are submitted. Depth is NDC z mapped to [0, 1] and cleared
+// to 1, pixel (0, 0) is the bottom left one like in GL.
+// addOccluder() sets triangles up and bins them into bands of TILE_SIZE rows; rasterize()
+// hands whole bands to a small pool of workers (and the calling thread), so every pixel
+// has one writer and the buffer doesn't depend on the thread count or timing. Each band
+// keeps the farthest depth of its TILE_SIZE x TILE_SIZE tiles, which lets visible() skip
+// tiles that are entirely in front of a box without looking at their pixels.
+// No GL calls are made, so the class can be used and checked without a context.
+class SoftwareOcclusion {
+public:
+    static const int TILE_SIZE = 8;
+
+    // width is rounded up to whole tiles so every row is a whole number of SIMD vectors
+    explicit SoftwareOcclusion(int width = 256, int height = 144,
+                               unsigned int threads = defaultThreadCount())
+            : m_Width(roundUp(std::max(width, 1))), m_Height(roundUp(std::max(height, 1))),
+              m_TilesX(m_Width / TILE_SIZE), m_TilesY(m_Height / TILE_SIZE),
+              m_Depth(m_Width * m_Height, 1.0f), m_TileMax(m_TilesX * m_TilesY, 1.0f), m_Bins(m_TilesY) {
+        for (unsigned int i = 0; i < threads; ++i) {
+            m_Workers.push_back(std::thread(&SoftwareOcclusion::work, this));
+        }
+    }
+
+    SoftwareOcclusion(const SoftwareOcclusion &) = delete;
+    SoftwareOcclusion &operator=(const SoftwareOcclusion &) = delete;
+
+    ~SoftwareOcclusion() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_Wake.notify_all();
+        for (std::thread &worker : m_Workers) {
+            worker.join();
+        }
+    }
+
+    // clears the buffer and the occluders, call once per frame before addOccluder()
+    void begin(const glm::mat4 &viewProjection) {
+        m_ViewProjection = viewProjection;
+        std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+        std::fill(m_TileMax.begin(), m_TileMax.end(), 1.0f);
+        m_Triangles.clear();
+        for (std::vector<unsigned int> &bin : m_Bins) {
+            bin.clear();
+        }
+        m_Stats = SoftwareOcclusionStats();
+    }
+
+    // queues the mesh's triangles, both sides of a triangle occlude
+    void addOccluder(const OccluderMesh &mesh, const glm::mat4 &model) {
+        glm::mat4 transform = m_ViewProjection * model;
+        m_Clip.resize(mesh.positions.size());
+        for (std::size_t i = 0; i < mesh.positions.size(); ++i) {
+            m_Clip[i] = transform * glm::vec4(mesh.positions[i], 1.0f);
+        }
+        for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            addClipped(m_Clip[mesh.indices[i]], m_Clip[mesh.indices[i + 1]], m_Clip[mesh.indices[i + 2]]);
+        }
+    }
+
+    // draws the queued occluders, visible() is valid afterwards
+    void rasterize() {
+        m_NextBand = 0;
+        if (!m_Workers.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_BusyWorkers = m_Workers.size();
+                ++m_Job;
+            }
+            m_Wake.notify_all();
+        }
+        rasterizeBands();
+        if (!m_Workers.empty()) {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Done.wait(lock, [this] { return m_BusyWorkers == 0; });
+        }
+    }
+
+    // false when the world space box is behind the occluders everywhere it covers the screen
+    bool visible(const AABB &box) {
+        ++m_Stats.tested;
+        if (!testBox(box)) {
+            ++m_Stats.hidden;
+            return false;
+        }
+        return true;
+    }
+
+    float depth(int x, int y) const {
+        return m_Depth[y * m_Width + x];
+    }
+
+    int width() const {
+        return m_Width;
+    }
+
+    int height() const {
+        return m_Height;
+    }
+
+    const SoftwareOcclusionStats &stats() const {
+        return m_Stats;
+    }
+
+    // leaves a core for the thread that submits the draws; the buffer is small, more don't help
+    static unsigned int defaultThreadCount() {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? std::min(cores - 1, 3u) : 0u;
+    }
+
+private:
+    // screen space triangle, inside where all three edge functions a * x + b * y + c are >= 0
+    struct Triangle {
+        float edges[3][3];
+        float depth[3]; // depth = depth[0] * x + depth[1] * y + depth[2]
+        int minX, maxX, minY, maxY;
+    };
+
+    int m_Width;
+    int m_Height;
+    int m_TilesX;
+    int m_TilesY;
+    std::vector<float> m_Depth;
+    std::vector<float> m_TileMax;
+    glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+    std::vector<glm::vec4> m_Clip;
+    std::vector<Triangle> m_Triangles;
+    std::vector<std::vector<unsigned int>> m_Bins; // triangle ids per band of TILE_SIZE rows
+    SoftwareOcclusionStats m_Stats;
+
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::condition_variable m_Done;
+    unsigned int m_Job = 0;
+    std::size_t m_BusyWorkers = 0;
+    bool m_Stop = false;
+    std::atomic<int> m_NextBand{0};
+
+    static int roundUp(int size) {
+        return (size + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+    }
+
+    void work() {
+        unsigned int seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Wake.wait(lock, [&] { return m_Stop || m_Job != seen; });
+                if (m_Stop) {
+                    return;
+                }
+                seen = m_Job;
+            }
+            rasterizeBands();
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                --m_BusyWorkers;
+            }
+            m_Done.notify_one();
+        }
+    }
+
+    // takes bands until none are left
+    void rasterizeBands() {
+        for (int band = m_NextBand++; band < m_TilesY; band = m_NextBand++) {
+            for (unsigned int triangle : m_Bins[band]) {
+                rasterizeTriangle(m_Triangles[triangle], band);
+            }
+            updateTileMax(band);
+        }
+    }
+
+    // clips against the near plane (z >= -w), which leaves up to two triangles with w > 0
+    void addClipped(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c) {
+        const glm::vec4 in[3] = {a, b, c};
+        glm::vec4 out[4];
+        int count = 0;
+        for (int i = 0; i < 3; ++i) {
+            const glm::vec4 &current = in[i];
+            const glm::vec4 &next = in[(i + 1) % 3];
+            float currentDistance = current.z + current.w;
+            float nextDistance = next.z + next.w;
+            if (currentDistance >= 0.0f) {
+                out[count++] = current;
+            }
+            if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+                float t = currentDistance / (currentDistance - nextDistance);
+                out[count++] = current + (next - current) * t;
+            }
+        }
+        for (int i = 2; i < count; ++i) {
+            addTriangle(out[0], out[i - 1], out[i]);
+        }
+    }
+
+    void addTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c) {
+        glm::vec3 v[3] = {toScreen(a), toScreen(b), toScreen(c)};
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+        if (std::fabs(area) < 1e-8f) {
+            return;
+        }
+        if (area < 0.0f) {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        Triangle triangle;
+        float minX = std::min(v[0].x, std::min(v[1].x, v[2].x));
+        float maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+        float minY = std::min(v[0].y, std::min(v[1].y, v[2].y));
+        float maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+        // pixels whose centers can be inside
+        triangle.minX = std::max(0, (int) std::ceil(minX - 0.5f));
+        triangle.maxX = std::min(m_Width - 1, (int) std::floor(maxX - 0.5f));
+        triangle.minY = std::max(0, (int) std::ceil(minY - 0.5f));
+        triangle.maxY = std::min(m_Height - 1, (int) std::floor(maxY - 0.5f));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            return;
+        }
+
+        // edge i is opposite vertex i and, divided by the area, is that vertex's barycentric weight
+        for (int i = 0; i < 3; ++i) {
+            const glm::vec3 &from = v[(i + 1) % 3];
+            const glm::vec3 &to = v[(i + 2) % 3];
+            float edgeA = from.y - to.y;
+            float edgeB = to.x - from.x;
+            triangle.edges[i][0] = edgeA;
+            triangle.edges[i][1] = edgeB;
+            triangle.edges[i][2] = -(edgeA * from.x + edgeB * from.y);
+        }
+        for (int k = 0; k < 3; ++k) {
+            triangle.depth[k] = (v[0].z * triangle.edges[0][k] + v[1].z * triangle.edges[1][k] +
+                                 v[2].z * triangle.edges[2][k]) / area;
+        }
+
+        unsigned int id = m_Triangles.size();
+        m_Triangles.push_back(triangle);
+        for (int band = triangle.minY / TILE_SIZE; band <= triangle.maxY / TILE_SIZE; ++band) {
+            m_Bins[band].push_back(id);
+        }
+        ++m_Stats.occluderTriangles;
+    }
+
+    glm::vec3 toScreen(const glm::vec4 &clip) const {
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * m_Width, (ndc.y * 0.5f + 0.5f) * m_Height, ndc.z * 0.5f + 0.5f);
+    }
+
+    // keeps the nearer depth for every pixel of the band whose center is inside the triangle
+    void rasterizeTriangle(const Triangle &triangle, int band) {
+        int firstRow = std::max(triangle.minY, band * TILE_SIZE);
+        int lastRow = std::min(triangle.maxY, band * TILE_SIZE + TILE_SIZE - 1);
+        for (int y = firstRow; y <= lastRow; ++y) {
+            float centerY = y + 0.5f;
+            float *row = &m_Depth[y * m_Width];
+            int x = triangle.minX;
+#if defined(__AVX__)
+            x = rasterizeRowAVX(triangle, row, centerY);
+#elif defined(__SSE__) || defined(_M_X64)
+            x = rasterizeRowSSE(triangle, row, centerY);
+#endif
+            for (; x <= triangle.maxX; ++x) {
+                float centerX = x + 0.5f;
+                bool inside = true;
+                for (const float *edge : triangle.edges) {
+                    inside = inside && edge[0] * centerX + edge[1] * centerY + edge[2] >= 0.0f;
+                }
+                if (inside) {
+                    float z = triangle.depth[0] * centerX + triangle.depth[1] * centerY + triangle.depth[2];
+                    row[x] = std::min(row[x], z);
+                }
+            }
+        }
+    }
+
+#if defined(__AVX__)
+    // whole vectors from the aligned start, rows are a whole number of them; returns where the scalar loop goes on
+    int rasterizeRowAVX(const Triangle &triangle, float *row, float centerY) {
+        int x = triangle.minX & ~7;
+        const __m256 lanes = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        for (; x <= triangle.maxX; x += 8) {
+            __m256 centerX = _mm256_add_ps(_mm256_set1_ps((float) x), lanes);
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (const float *edge : triangle.edges) {
+                __m256 value = _mm256_add_ps(_mm256_mul_ps(centerX, _mm256_set1_ps(edge[0])),
+                                             _mm256_set1_ps(edge[1] * centerY + edge[2]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+            if (_mm256_movemask_ps(inside) == 0) {
+                continue;
+            }
+            __m256 z = _mm256_add_ps(_mm256_mul_ps(centerX, _mm256_set1_ps(triangle.depth[0])),
+                                     _mm256_set1_ps(triangle.depth[1] * centerY + triangle.depth[2]));
+            __m256 current = _mm256_loadu_ps(row + x);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+        }
+        return x;
+    }
+#elif defined(__SSE__) || defined(_M_X64)
+    int rasterizeRowSSE(const Triangle &triangle, float *row, float centerY) {
+        int x = triangle.minX & ~3;
+        const __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        for (; x <= triangle.maxX; x += 4) {
+            __m128 centerX = _mm_add_ps(_mm_set1_ps((float) x), lanes);
+            __m128 inside = _mm_cmpeq_ps(centerX, centerX);
+            for (const float *edge : triangle.edges) {
+                __m128 value = _mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(edge[0])),
+                                          _mm_set1_ps(edge[1] * centerY + edge[2]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(value, _mm_setzero_ps()));
+            }
+            if (_mm_movemask_ps(inside) == 0) {
+                continue;
+            }
+            __m128 z = _mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(triangle.depth[0])),
+                                  _mm_set1_ps(triangle.depth[1] * centerY + triangle.depth[2]));
+            __m128 current = _mm_loadu_ps(row + x);
+            __m128 nearer = _mm_min_ps(current, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+        }
+        return x;
+    }
+#endif
+
+    void updateTileMax(int band) {
+        for (int tileX = 0; tileX < m_TilesX; ++tileX) {
+            float farthest = 0.0f;
+            for (int y = band * TILE_SIZE; y < (band + 1) * TILE_SIZE; ++y) {
+                const float *row = &m_Depth[y * m_Width + tileX * TILE_SIZE];
+                for (int x = 0; x < TILE_SIZE; ++x) {
+                    farthest = std::max(farthest, row[x]);
+                }
+            }
+            m_TileMax[band * m_TilesX + tileX] = farthest;
+        }
+    }
+
+    bool testBox(const AABB &box) const {
+        float nearest = 1.0f;
+        float minX = m_Width, maxX = 0.0f, minY = m_Height, maxY = 0.0f;
+        for (int corner = 0; corner < 8; ++corner) {
+            glm::vec3 point((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y,
+                            (corner & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = m_ViewProjection * glm::vec4(point, 1.0f);
+            // a box reaching past the near plane has no sensible screen rectangle
+            if (clip.z < -clip.w || clip.w <= 0.0f) {
+                return true;
+            }
+            glm::vec3 screen = toScreen(clip);
+            nearest = std::min(nearest, screen.z);
+            minX = std::min(minX, screen.x);
+            maxX = std::max(maxX, screen.x);
+            minY = std::min(minY, screen.y);
+            maxY = std::max(maxY, screen.y);
+        }
+        // one pixel of margin around the rectangle makes up for occluder edges covering whole pixels
+        int x0 = std::max(0, (int) std::floor(minX) - 1);
+        int x1 = std::min(m_Width - 1, (int) std::floor(maxX) + 1);
+        int y0 = std::max(0, (int) std::floor(minY) - 1);
+        int y1 = std::min(m_Height - 1, (int) std::floor(maxY) + 1);
+        if (x0 > x1 || y0 > y1) {
+            return false;
+        }
+        for (int tileY = y0 / TILE_SIZE; tileY <= y1 / TILE_SIZE; ++tileY) {
+            for (int tileX = x0 / TILE_SIZE; tileX <= x1 / TILE_SIZE; ++tileX) {
+                if (m_TileMax[tileY * m_TilesX + tileX] < nearest) {
+                    continue;
+                }
+                int rowEnd = std::min(y1, tileY * TILE_SIZE + TILE_SIZE - 1);
+                int columnEnd = std::min(x1, tileX * TILE_SIZE + TILE_SIZE - 1);
+                for (int y = std::max(y0, tileY * TILE_SIZE); y <= rowEnd; ++y) {
+                    for (int x = std::max(x0, tileX * TILE_SIZE); x <= columnEnd; ++x) {
+                        if (m_Depth[y * m_Width + x] >= nearest) {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+};
+
+#endif //PROJECT_BASE_SOFTWAREOCCLUSION_H
@@ -0,0 +1,215 @@
+#ifndef PROJECT_BASE_STREAMBUFFER_H
+#define PROJECT_BASE_STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include <rg/GLFeatures.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// frames the CPU may run ahead of the GPU, each writes its own region of the ring
+#define STREAM_FRAMES 3
+// bytes per region until a frame needs more
+#define STREAM_FRAME_SIZE (1u << 20)
+
+// where write() put the data. Only valid while holds() says so: a region is written
+// again STREAM_FRAMES frames later, and all of them move when the ring grows.
+struct StreamRange {
+    unsigned int buffer = 0;
+    std::size_t offset = 0;
+    unsigned int frame = 0;
+    unsigned int generation = 0;
+};
+
+// data streamed by the last finished frame
+struct StreamBufferStats {
+    std::size_t bytes = 0;
+    std::size_t capacity = 0;  // bytes one frame can write before the ring grows
+    unsigned int writes = 0;
+    unsigned int stalls = 0;   // ends of frame that had to wait for the GPU to free a region
+    unsigned int grows = 0;    // since start
+    bool persistent = false;
+};
+
+inline std::ostream &operator<<(std::ostream &out, const StreamBufferStats &stats) {
+    return out << stats.writes << " writes, " << stats.bytes / 1024 << " of " << stats.capacity / 1024
+               << " KB per frame, " << stats.stalls << " stalls, " << stats.grows << " grows"
+               << (stats.persistent ? "" : " (GL 3.3 fallback)");
+}
+
+// Ring buffer for data that changes every frame (instance attributes, indirect commands,
+// uniform blocks). It is split into STREAM_FRAMES regions; a frame writes into its own region
+// and endFrame() fences it, so a region is only written again once the GPU is done with it and
+// no GL buffer is ever re-specified. With GL 4.4 or ARB_buffer_storage the buffer stays mapped
+// persistently and coherently and write() is a memcpy; on GL 3.3 each write maps its range
+// with GL_MAP_UNSYNCHRONIZED_BIT, which the fences make safe.
+class StreamBuffer {
+public:
+    static StreamBuffer &current() {
+        static StreamBuffer buffer;
+        return buffer;
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // copies size bytes into this frame's region, aligned for any use including uniform and storage blocks
+    StreamRange write(const void *data, std::size_t size) {
+        create(size);
+        std::size_t offset = align(m_Cursor);
+        if (offset + size > m_FrameSize) {
+            grow(size);
+            offset = 0;
+        }
+        std::size_t start = m_Region * m_FrameSize + offset;
+        if (m_Mapped) {
+            std::memcpy(m_Mapped + start, data, size);
+        } else if (size > 0) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_Id);
+            void *target = glMapBufferRange(GL_COPY_WRITE_BUFFER, start, size,
+                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (target) {
+                std::memcpy(target, data, size);
+                glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        m_Cursor = offset + size;
+        ++m_Frame.writes;
+        m_Frame.bytes = m_Cursor;
+        StreamRange range;
+        range.buffer = m_Id;
+        range.offset = start;
+        range.frame = m_FrameIndex;
+        range.generation = m_Generation;
+        return range;
+    }
+
+    // whether the range's data is still there for this frame's draws
+    bool holds(const StreamRange &range) const {
+        return range.buffer != 0 && range.generation == m_Generation && m_FrameIndex - range.frame < STREAM_FRAMES;
+    }
+
+    // call once per frame after its last draw: fences the frame's region and waits until the GPU has
+    // finished with the region the next frame writes into
+    void endFrame() {
+        if (m_Id == 0) {
+            return;
+        }
+        // the frame's draws are issued, GL keeps what they read alive on its own
+        if (!m_Retired.empty()) {
+            glDeleteBuffers(m_Retired.size(), m_Retired.data());
+            m_Retired.clear();
+        }
+        if (m_Fences[m_Region]) {
+            glDeleteSync(m_Fences[m_Region]);
+        }
+        m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_Region = (m_Region + 1) % STREAM_FRAMES;
+        if (m_Fences[m_Region] && wait(m_Fences[m_Region])) {
+            ++m_Frame.stalls;
+        }
+        m_Cursor = 0;
+        ++m_FrameIndex;
+        m_Frame.capacity = m_FrameSize;
+        m_Frame.grows = m_Grows;
+        m_Frame.persistent = m_Mapped != nullptr;
+        m_Stats = m_Frame;
+        m_Frame = StreamBufferStats();
+    }
+
+    const StreamBufferStats &stats() const {
+        return m_Stats;
+    }
+
+private:
+    unsigned int m_Id = 0;
+    unsigned char *m_Mapped = nullptr; // the whole ring when persistently mapped
+    std::size_t m_FrameSize = 0;
+    std::size_t m_Alignment = 16;
+    std::size_t m_Cursor = 0;
+    unsigned int m_Region = 0;
+    unsigned int m_FrameIndex = 0;
+    unsigned int m_Generation = 0;
+    unsigned int m_Grows = 0;
+    GLsync m_Fences[STREAM_FRAMES] = {};
+    std::vector<unsigned int> m_Retired; // rings replaced by grow() this frame
+    StreamBufferStats m_Frame;
+    StreamBufferStats m_Stats;
+
+    StreamBuffer() = default;
+
+    std::size_t align(std::size_t offset) const {
+        return (offset + m_Alignment - 1) / m_Alignment * m_Alignment;
+    }
+
+    // the first write creates the ring, GLFeatures is loaded by then
+    void create(std::size_t size) {
+        if (m_Id != 0) {
+            return;
+        }
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        m_Alignment = std::max<std::size_t>(m_Alignment, alignment);
+        if (GLFeatures::current().computeShader) {
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            m_Alignment = std::max<std::size_t>(m_Alignment, alignment);
+        }
+        allocate(std::max<std::size_t>(STREAM_FRAME_SIZE, align(size)));
+    }
+
+    void allocate(std::size_t frameSize) {
+        GLFeatures &features = GLFeatures::current();
+        m_FrameSize = frameSize;
+        std::size_t total = m_FrameSize * STREAM_FRAMES;
+        glGenBuffers(1, &m_Id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Id);
+        if (features.persistentMapping) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            features.bufferStorage(GL_COPY_WRITE_BUFFER, total, nullptr, flags);
+            m_Mapped = (unsigned char *) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags);
+        } else {
+            glBufferData(GL_COPY_WRITE_BUFFER, total, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // A frame outgrew its region: waits for every frame in flight and moves to a ring twice as
+    // large. The old ring lives until the end of the frame, ranges written before stay bound.
+    void grow(std::size_t size) {
+        for (GLsync &fence : m_Fences) {
+            if (fence) {
+                wait(fence);
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+        std::size_t frameSize = std::max(2 * m_FrameSize, align(size));
+        std::cout << "WARNING::STREAM_BUFFER:: A frame needs more than " << m_FrameSize / 1024
+                  << " KB, growing to " << frameSize / 1024 << " KB" << std::endl;
+        // deleting the old ring also unmaps it
+        m_Retired.push_back(m_Id);
+        m_Mapped = nullptr;
+        allocate(frameSize);
+        m_Region = 0;
+        m_Cursor = 0;
+        ++m_Generation;
+        ++m_Grows;
+    }
+
+    // returns true if the GPU was not done yet
+    static bool wait(GLsync fence) {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+            return false;
+        }
+        while (result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        return true;
+    }
+};
+
+#endif //PROJECT_BASE_STREAMBUFFER_H
@@ -0,0 +1,149 @@
+#ifndef PROJECT_BASE_TEXTUREARRAYPOOL_H
+#define PROJECT_BASE_TEXTUREARRAYPOOL_H
+
+#include <glad/glad.h>
+#include <rg/GLState.h>
+#include <rg/GLFeatures.h>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// where a 2D texture was copied to, layer -1 means the texture is not in the pool
+struct TextureLayer {
+    unsigned int array = 0;
+    int layer = -1;
+};
+
+// Copies already loaded 2D textures into GL_TEXTURE_2D_ARRAYs, one array per texture size,
+// so draws with different textures of the same size only differ in a layer index.
+// Layers are RGBA8; the copy goes through the framebuffer, which expands one- and
+// three-channel textures exactly like sampling them would.
+// With ARB_bindless_texture every array also gets a resident handle.
+class TextureArrayPool {
+public:
+    // queues a texture for build(), 0 and duplicates are ignored
+    void add(unsigned int texture) {
+        if (texture == 0 || m_Built || findEntry(texture)) {
+            return;
+        }
+        Entry entry;
+        entry.texture = texture;
+        m_Entries.push_back(entry);
+    }
+
+    void build() {
+        if (m_Built) {
+            return;
+        }
+        m_Built = true;
+        GLState &gl = GLState::current();
+
+        // group by size
+        for (Entry &entry : m_Entries) {
+            gl.bindTexture(0, GL_TEXTURE_2D, entry.texture);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &entry.width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &entry.height);
+            Array *array = findArray(entry.width, entry.height);
+            if (!array) {
+                m_Arrays.push_back({0, entry.width, entry.height, 0, 0});
+                array = &m_Arrays.back();
+            }
+            entry.location.layer = array->layers++;
+        }
+
+        for (Array &array : m_Arrays) {
+            glGenTextures(1, &array.id);
+            gl.bindTexture(0, GL_TEXTURE_2D_ARRAY, array.id);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, array.width, array.height, array.layers, 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+
+        unsigned int framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        gl.bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        for (Entry &entry : m_Entries) {
+            const Array &array = *findArray(entry.width, entry.height);
+            entry.location.array = array.id;
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, entry.texture, 0);
+            gl.bindTexture(0, GL_TEXTURE_2D_ARRAY, array.id);
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, entry.location.layer, 0, 0, entry.width, entry.height);
+        }
+        gl.bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+
+        GLFeatures &features = GLFeatures::current();
+        for (Array &array : m_Arrays) {
+            gl.bindTexture(0, GL_TEXTURE_2D_ARRAY, array.id);
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            // a texture can't be modified once it has a handle, so this comes last
+            if (features.bindlessTexture) {
+                array.handle = features.getTextureHandle(array.id);
+                features.makeTextureHandleResident(array.handle);
+            }
+        }
+    }
+
+    // valid after build()
+    TextureLayer find(unsigned int texture) const {
+        const Entry *entry = findEntry(texture);
+        return entry ? entry->location : TextureLayer();
+    }
+
+    // bindless handle of an array, 0 without ARB_bindless_texture
+    uint64_t handle(unsigned int array) const {
+        for (const Array &candidate : m_Arrays) {
+            if (candidate.id == array) {
+                return candidate.handle;
+            }
+        }
+        return 0;
+    }
+
+    std::size_t arrayCount() const {
+        return m_Arrays.size();
+    }
+
+private:
+    struct Entry {
+        unsigned int texture = 0;
+        int width = 0;
+        int height = 0;
+        TextureLayer location;
+    };
+
+    struct Array {
+        unsigned int id;
+        int width;
+        int height;
+        int layers;
+        uint64_t handle;
+    };
+
+    std::vector<Entry> m_Entries;
+    std::vector<Array> m_Arrays;
+    bool m_Built = false;
+
+    const Entry *findEntry(unsigned int texture) const {
+        for (const Entry &entry : m_Entries) {
+            if (entry.texture == texture) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    Array *findArray(int width, int height) {
+        for (Array &array : m_Arrays) {
+            if (array.width == width && array.height == height) {
+                return &array;
+            }
+        }
+        return nullptr;
+    }
+};
+
+#endif //PROJECT_BASE_TEXTUREARRAYPOOL_H
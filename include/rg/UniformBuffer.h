@@ -0,0 +1,127 @@
+#ifndef PROJECT_BASE_UNIFORMBUFFER_H
+#define PROJECT_BASE_UNIFORMBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/StreamBuffer.h>
+#include <cstddef>
+#include <cstdint>
+
+// fixed binding points shared by every program, see Shader::bindUniformBlock
+enum UniformBlockBinding : unsigned int {
+    CAMERA_BLOCK_BINDING = 0,
+    LIGHTS_BLOCK_BINDING = 1,
+    MATERIAL_BLOCK_BINDING = 2
+};
+
+// std140 mirrors of the uniform blocks declared in the shaders.
+// every vec3 is followed by a float so the C++ layout matches std140 without hidden padding.
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float padding;
+    glm::mat4 viewProjection; // projection * view, so vertex shaders multiply once
+};
+
+struct PointLightBlock {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+
+struct SpotLightBlock {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 direction;
+    float linear;
+    glm::vec3 ambient;
+    float quadratic;
+    glm::vec3 diffuse;
+    float cutOff;
+    glm::vec3 specular;
+    float outerCutOff;
+};
+
+#define NR_POINT_LIGHTS 2
+
+struct LightsBlock {
+    PointLightBlock pointLights[NR_POINT_LIGHTS];
+    SpotLightBlock spotLight;
+};
+
+struct MaterialBlock {
+    float shininess;
+    float heightScale;
+    float padding[2];
+};
+
+static_assert(sizeof(CameraBlock) == 208, "CameraBlock does not match the std140 layout");
+static_assert(sizeof(PointLightBlock) == 64, "PointLightBlock does not match the std140 layout");
+static_assert(sizeof(SpotLightBlock) == 80, "SpotLightBlock does not match the std140 layout");
+static_assert(sizeof(MaterialBlock) == 16, "MaterialBlock does not match the std140 layout");
+
+// A uniform block bound to a fixed binding point with a CPU-side copy of its contents.
+// Edit `data` freely; upload() writes it into the StreamBuffer and binds that range, but only
+// when the contents hash changed or the ring is about to reuse the last copy.
+template <typename T>
+class UniformBuffer {
+public:
+    T data;
+
+    explicit UniformBuffer(unsigned int binding)
+            : data()
+            , m_Binding(binding) {
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    // returns true if the block was actually written, call every frame before the block's draws
+    bool upload() {
+        uint64_t hash = hashContents();
+        StreamBuffer &stream = StreamBuffer::current();
+        if (m_Uploaded && hash == m_UploadedHash && stream.holds(m_Range)) {
+            return false;
+        }
+        m_Range = stream.write(&data, sizeof(T));
+        glBindBufferRange(GL_UNIFORM_BUFFER, m_Binding, m_Range.buffer, m_Range.offset, sizeof(T));
+        m_UploadedHash = hash;
+        m_Uploaded = true;
+        ++m_UploadCount;
+        return true;
+    }
+
+    unsigned int binding() const {
+        return m_Binding;
+    }
+
+    unsigned int uploadCount() const {
+        return m_UploadCount;
+    }
+
+private:
+    StreamRange m_Range;
+    unsigned int m_Binding;
+    bool m_Uploaded = false;
+    uint64_t m_UploadedHash = 0;
+    unsigned int m_UploadCount = 0;
+
+    // FNV-1a over the raw bytes, blocks are a few hundred bytes at most
+    uint64_t hashContents() const {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&data);
+        uint64_t hash = 14695981039346656037ull;
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+#endif //PROJECT_BASE_UNIFORMBUFFER_H
@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aModel; // per-instance model matrix, or a constant attribute for uniform-model draws
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    mat4 viewProjection;
+};
+
+// the main pass tests against this depth with GL_EQUAL, so the position is computed exactly
+// like object.vs, object_batch.vs and light_source.vs do
+invariant gl_Position;
+
+void main()
+{
+    vec3 worldPos = vec3(aModel * vec4(aPos, 1.0));
+    gl_Position = viewProjection * vec4(worldPos, 1.0);
+}
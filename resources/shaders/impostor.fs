@@ -0,0 +1,177 @@
+#version 330 core
+out vec4 FragColor;
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+};
+
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 2
+#endif
+
+layout (std140) uniform Lights {
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    mat4 viewProjection;
+};
+
+layout (std140) uniform MaterialParams {
+    float shininess;
+    float heightScale;
+};
+
+#define GRID 8
+
+in vec2 QuadPos;
+in vec3 FragPos;
+in vec3 DepthDir;
+in vec4 ClipPos;
+in vec4 ClipDir;
+in mat3 NormalMatrix;
+flat in ivec4 Cells;
+flat in vec2 CellWeights;
+flat in float Fade;
+flat in uint LightList; // lights that reach this copy, packed by LightCuller
+
+// baked views, see Impostor
+uniform sampler2D colorAtlas;
+uniform sampler2D normalDepthAtlas;
+
+vec3 diffuseColor;
+vec3 specularColor;
+
+// function prototypes
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+
+// 4x4 ordered dither, a fading impostor drops a growing share of its pixels instead of blending
+const float bayer[16] = float[](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy) % 4;
+    if (Fade <= (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0)
+        discard;
+
+    // blend the four nearest views, each weighted by how much of the model it shows here
+    vec2 uv = QuadPos * 0.5 + 0.5;
+    ivec2 cells[4] = ivec2[](Cells.xy, Cells.zy, Cells.xw, Cells.zw);
+    float weights[4] = float[]((1.0 - CellWeights.x) * (1.0 - CellWeights.y), CellWeights.x * (1.0 - CellWeights.y),
+                               (1.0 - CellWeights.x) * CellWeights.y, CellWeights.x * CellWeights.y);
+    vec3 color = vec3(0.0);
+    vec4 normalDepth = vec4(0.0);
+    float coverage = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        vec2 atlasUV = (vec2(cells[i]) + uv) / GRID;
+        vec4 baked = texture(colorAtlas, atlasUV);
+        float weight = weights[i] * baked.a;
+        color += baked.rgb * weight;
+        normalDepth += texture(normalDepthAtlas, atlasUV) * weight;
+        coverage += weight;
+    }
+    if (coverage < 0.5)
+        discard;
+    color /= coverage;
+    normalDepth /= coverage;
+
+    // depth 0 is the front of the bounding sphere and 1 its back, the quad lies halfway
+    float offset = 1.0 - 2.0 * normalDepth.a;
+    vec4 clip = ClipPos + ClipDir * offset;
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+    vec3 fragPos = FragPos + DepthDir * offset;
+
+    // properties
+    vec3 norm = normalize(NormalMatrix * (normalDepth.rgb * 2.0 - 1.0));
+    vec3 viewDir = normalize(viewPos - fragPos);
+    diffuseColor = color;
+    // far away the highlights are too small to matter, the atlas doesn't keep specular
+    specularColor = vec3(0.0);
+
+    // phase 1: directional lighting
+    vec3 result = vec3(0.0);
+    // phase 2: point lights, only the ones that reach the object (see LightCuller)
+    uint pointLightCount = LightList & 15u;
+    for(uint i = 0u; i < pointLightCount; i++)
+        result += CalcPointLight(pointLights[(LightList >> (4u + 4u * i)) & 15u], norm, fragPos, viewDir);
+    // phase 3: spot light, only compiled into the variants that have it on
+#ifdef SPOT_LIGHT
+    if ((LightList & 0x80000000u) != 0u)
+        result += CalcSpotLight(spotLight, norm, fragPos, viewDir);
+#endif
+
+    FragColor = vec4(result, 1.0);
+}
+
+// calculates the color when using a point light.
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // combine results
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
+
+// calculates the color when using a spot light.
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // combine results
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    return (ambient + diffuse + specular);
+}
\ No newline at end of file
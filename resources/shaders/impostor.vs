@@ -0,0 +1,45 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner; // quad corner in [-1, 1]^2
+// per-instance, set up by Impostor::Submit from the copy's model matrix and the camera
+layout (location = 5) in vec4 aCenter;  // xyz: world center of the bounding sphere, w: fade in [0, 1]
+layout (location = 6) in vec3 aRight;   // world offsets from the center to the quad's right and top edges
+layout (location = 7) in vec3 aUp;
+layout (location = 8) in vec3 aDepthDir; // world offset from the center to the front of the sphere
+layout (location = 9) in ivec4 aCells;   // the two columns and rows of the nearest baked views
+layout (location = 10) in vec2 aCellWeights;
+layout (location = 11) in uint aLights;  // light list, see LightCuller
+layout (location = 12) in mat3 aNormalMatrix;
+
+out vec2 QuadPos;
+out vec3 FragPos;  // on the quad through the sphere's center
+out vec3 DepthDir; // world offset from the quad to the front of the sphere
+out vec4 ClipPos;
+out vec4 ClipDir;
+out mat3 NormalMatrix;
+flat out ivec4 Cells;
+flat out vec2 CellWeights;
+flat out float Fade;
+flat out uint LightList;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    mat4 viewProjection;
+};
+
+void main()
+{
+    Cells = aCells;
+    CellWeights = aCellWeights;
+    Fade = aCenter.w;
+    LightList = aLights;
+
+    QuadPos = aCorner;
+    FragPos = aCenter.xyz + aRight * aCorner.x + aUp * aCorner.y;
+    DepthDir = aDepthDir;
+    ClipPos = viewProjection * vec4(FragPos, 1.0);
+    ClipDir = viewProjection * vec4(DepthDir, 0.0);
+    NormalMatrix = aNormalMatrix;
+    gl_Position = ClipPos;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) out vec4 Color;       // rgb = diffuse, a = coverage
+layout (location = 1) out vec4 NormalDepth; // rgb = model space normal * 0.5 + 0.5, a = depth from the front of the bounding sphere
+
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+    // faces are baked from both sides, the normal always points at the camera
+    vec3 normal = normalize(Normal);
+    if (!gl_FrontFacing)
+        normal = -normal;
+    Color = vec4(texture(texture_diffuse1, TexCoords).rgb, 1.0);
+    NormalDepth = vec4(normal * 0.5 + 0.5, gl_FragCoord.z);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec3 Normal;
+out vec2 TexCoords;
+
+// orthographic view of the model from one of the impostor's directions, in model space
+uniform mat4 viewProjection;
+
+void main()
+{
+    Normal = aNormal;
+    TexCoords = aTexCoords;
+    gl_Position = viewProjection * vec4(aPos, 1.0);
+}
@@ -2,15 +2,23 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aModel; // per-instance model matrix
 
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    mat4 viewProjection;
+};
+
+// the depth pre-pass computes the same position, see depth_prepass.vs
+invariant gl_Position;
 
 void main()
 {
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 worldPos = vec3(aModel * vec4(aPos, 1.0));
+    gl_Position = viewProjection * vec4(worldPos, 1.0);
 }
\ No newline at end of file
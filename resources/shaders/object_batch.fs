@@ -0,0 +1,135 @@
+#version 330 core
+out vec4 FragColor;
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+};
+
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 2
+#endif
+
+layout (std140) uniform Lights {
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    mat4 viewProjection;
+};
+
+layout (std140) uniform MaterialParams {
+    float shininess;
+    float heightScale;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+flat in ivec2 Layers;
+flat in uint LightList; // lights that reach this instance, packed by LightCuller
+
+// material textures, the layer of each comes with the instance
+uniform sampler2DArray diffuseArray;
+uniform sampler2DArray specularArray;
+
+vec3 diffuseColor;
+vec3 specularColor;
+
+// function prototypes
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+
+void main()
+{
+    // properties
+    vec3 norm = normalize(Normal);
+    vec3 viewDir = normalize(viewPos - FragPos);
+    // a missing texture samples black, like an unbound sampler2D
+    diffuseColor = Layers.x >= 0 ? texture(diffuseArray, vec3(TexCoords, Layers.x)).rgb : vec3(0.0);
+    specularColor = Layers.y >= 0 ? texture(specularArray, vec3(TexCoords, Layers.y)).rgb : vec3(0.0);
+
+    // phase 1: directional lighting
+    vec3 result = vec3(0.0);
+    // phase 2: point lights, only the ones that reach the object (see LightCuller)
+    uint pointLightCount = LightList & 15u;
+    for(uint i = 0u; i < pointLightCount; i++)
+        result += CalcPointLight(pointLights[(LightList >> (4u + 4u * i)) & 15u], norm, FragPos, viewDir);
+    // phase 3: spot light, only compiled into the variants that have it on
+#ifdef SPOT_LIGHT
+    if ((LightList & 0x80000000u) != 0u)
+        result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+#endif
+
+    FragColor = vec4(result, 1.0);
+}
+
+// calculates the color when using a point light.
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // combine results
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
+
+// calculates the color when using a spot light.
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // combine results
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    return (ambient + diffuse + specular);
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aModel; // per-instance model matrix
+layout (location = 9) in ivec2 aLayers; // per-instance diffuse and specular texture array layers
+layout (location = 10) in uvec4 aHandles; // per-instance bindless array handles, only read by object_batch_bindless.fs
+layout (location = 11) in uint aLights; // per-instance light list, see LightCuller
+layout (location = 12) in mat3 aNormalMatrix; // per-instance normal matrix
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+flat out ivec2 Layers;
+flat out uvec4 Handles;
+flat out uint LightList;
+
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    mat4 viewProjection;
+};
+
+// same position as depth_prepass.vs computes for the batch's pre-pass
+invariant gl_Position;
+
+void main()
+{
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    Normal = aNormalMatrix * aNormal;
+    TexCoords = aTexCoords;
+    Layers = aLayers;
+    Handles = aHandles;
+    LightList = aLights;
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -1,11 +1,15 @@
 #version 330 core
 out vec4 FragColor;
 
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 2
+#endif
+
 in VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
-    vec3 TangentLightPos[2];
+    vec3 TangentLightPos[NR_POINT_LIGHTS];
     vec3 TangentLightDir;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
@@ -13,44 +17,46 @@ in VS_OUT {
 
 struct PointLight {
     vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
     float constant;
+    vec3 direction;
     float linear;
-    float quadratic;
-
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
+    float cutOff;
     vec3 specular;
+    float outerCutOff;
+};
+
+layout (std140) uniform Lights {
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
 };
 
 struct Material {
     sampler2D diffuseMap;
     sampler2D depthMap;
     sampler2D normalMap;
-
-    float shininess;
 };
 
 uniform Material material;
-uniform PointLight pointLight[2];
-uniform SpotLight spotLight;
-uniform vec3 viewPosition;
-uniform float heightScale;
+// lights that reach this object, packed by LightCuller
+uniform uint lights;
+
+layout (std140) uniform MaterialParams {
+    float shininess;
+    float heightScale;
+};
 
 // function prototypes
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 TangentLightPos, vec2 TexCoords);
@@ -74,10 +80,17 @@ void main()
     normal = normalize(normal * 2.0 - 1.0);
 
     vec3 result = vec3(0.0);
-    for(int i = 0; i < 2; i++){
-        result += CalcPointLight(pointLight[i], normal, viewDir, fs_in.TangentLightPos[i], texCoords);
+    // only the lights that reach the object (see LightCuller)
+    uint pointLightCount = lights & 15u;
+    for(uint i = 0u; i < pointLightCount; i++){
+        uint light = (lights >> (4u + 4u * i)) & 15u;
+        result += CalcPointLight(pointLights[light], normal, viewDir, fs_in.TangentLightPos[light], texCoords);
     }
-    result+=CalcSpotLight(spotLight,normal,fs_in.TangentFragPos,viewDir,texCoords);
+    // the spot light is only compiled into the variants that have it on
+#ifdef SPOT_LIGHT
+    if ((lights & 0x80000000u) != 0u)
+        result+=CalcSpotLight(spotLight,normal,fs_in.TangentFragPos,viewDir,texCoords);
+#endif
     FragColor = vec4(result, 1.0);
 }
 
@@ -93,7 +106,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 TangentLig
     float spec = 0.0f;
 
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
 
 
     // attenuation
@@ -117,7 +130,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 TangentLig
      float diff = max(dot(normal, lightDir), 0.0);
      // specular shading
      vec3 halfwayDir = normalize(lightDir + viewDir);
-     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+     float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
      // attenuation
      float distance = length(light.position - fragPos);
      float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
@@ -5,24 +5,59 @@ layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBitangent;
 
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 2
+#endif
+
 out VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
-    vec3 TangentLightPos[2];
+    vec3 TangentLightPos[NR_POINT_LIGHTS];
     vec3 TangentLightDir;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
 } vs_out;
 
 
-uniform mat4 projection;
-uniform mat4 view;
 uniform mat4 model;
 
-uniform vec3 lightPos[2];
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    mat4 viewProjection;
+};
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+};
+
+layout (std140) uniform Lights {
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+
 uniform vec3 lightDir;
-uniform vec3 viewPos;
 
 void main()
 {
@@ -34,8 +69,8 @@ void main()
     vec3 N = normalize(mat3(model) * aNormal);
     mat3 TBN = transpose(mat3(T, B, N));
 
-    for(int i = 0; i < 2; i++){
-        vs_out.TangentLightPos[i] = TBN * lightPos[i];
+    for(int i = 0; i < NR_POINT_LIGHTS; i++){
+        vs_out.TangentLightPos[i] = TBN * pointLights[i].position;
     }
 
     vs_out.TangentViewPos  = TBN * viewPos;
@@ -44,5 +79,5 @@ void main()
     vs_out.Normal = aNormal;
     vs_out.TangentLightDir = TBN * lightDir;
 
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = viewProjection * vec4(vs_out.FragPos, 1.0);
 }
\ No newline at end of file
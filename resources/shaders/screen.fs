@@ -4,8 +4,7 @@ out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2DMS screenTexture;
-uniform bool grayscale;
-uniform bool inversion;
+// GRAYSCALE or INVERSION select the effect at compile time, GRAYSCALE wins if both are set
 
 void main()
 {
@@ -18,13 +17,11 @@ void main()
 
     vec3 col = 0.25 * (sample0 + sample1 + sample2 + sample3);
 
-    if (grayscale) {
-        float gray = 0.2126 * col.r + 0.7152 * col.g + 0.0722 * col.b;
-        FragColor = vec4(vec3(gray), 1.0);
-    }
-    else if(inversion){
-        FragColor=vec4(vec3(1-col),1.0);
-    }
+#if defined(GRAYSCALE)
+    float gray = 0.2126 * col.r + 0.7152 * col.g + 0.0722 * col.b;
+    FragColor = vec4(vec3(gray), 1.0);
+#elif defined(INVERSION)
+    FragColor=vec4(vec3(1-col),1.0);
 //     else if(inversion){
 //             const float offset = 1.0 / 300.0;
 //
@@ -61,7 +58,7 @@ void main()
 //             }
 //             FragColor=vec4(col,1.0);
 //         }
-    else{
-        FragColor = vec4(vec3(col), 1.0);
-    }
+#else
+    FragColor = vec4(vec3(col), 1.0);
+#endif
 }
\ No newline at end of file
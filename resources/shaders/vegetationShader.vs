@@ -1,15 +1,45 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoords;
+layout (location = 0) in vec4 aClump;        // xyz: base of the clump, w: distance between rings
+layout (location = 1) in uvec2 aClumpLayout; // x: ring count, y: blades per ring
 
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    mat4 viewProjection;
+};
+
+// every blade is a unit quad hinged on the clump axis
+const vec2 bladeCorners[6] = vec2[](
+    vec2(0.0, 0.5), vec2(0.0, -0.5), vec2(1.0, -0.5),
+    vec2(0.0, 0.5), vec2(1.0, -0.5), vec2(1.0, 0.5)
+);
+// swapped y coordinates because texture is flipped upside down
+const vec2 bladeTexCoords[6] = vec2[](
+    vec2(0.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 1.0),
+    vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(1.0, 0.0)
+);
 
 void main()
 {
-    TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    uint blade = uint(gl_VertexID) / 6u;
+    int corner = gl_VertexID % 6;
+    uint ring = blade / aClumpLayout.y;
+    if (ring >= aClumpLayout.x) {
+        // this clump has fewer blades than the draw, collapse the triangle
+        TexCoords = vec2(0.0);
+        gl_Position = vec4(0.0);
+        return;
+    }
+
+    float angle = radians(360.0) * float(blade % aClumpLayout.y) / float(aClumpLayout.y);
+    vec2 corner2D = bladeCorners[corner];
+    // rotation around the y axis
+    vec3 offset = vec3(corner2D.x * cos(angle), corner2D.y, -corner2D.x * sin(angle));
+    vec3 worldPos = aClump.xyz + vec3(0.0, aClump.w * float(ring), 0.0) + offset;
+
+    TexCoords = bladeTexCoords[corner];
+    gl_Position = viewProjection * vec4(worldPos, 1.0);
+}
@@ -7,17 +7,99 @@
 
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader_m.h>
+#include <learnopengl/shader_c.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
-
+#include <rg/UniformBuffer.h>
+#include <rg/InstanceBuffer.h>
+#include <rg/StreamBuffer.h>
+#include <rg/Foliage.h>
+#include <rg/RenderQueue.h>
+#include <rg/Material.h>
+#include <rg/GLState.h>
+#include <rg/GLFeatures.h>
+#include <rg/MultiDrawBatch.h>
+#include <rg/SceneGraph.h>
+#include <rg/HiZBuffer.h>
+#include <rg/OcclusionQueries.h>
+#include <rg/SoftwareOcclusion.h>
+#include <rg/Impostor.h>
+#include <rg/LightCulling.h>
+#include <rg/FrameQueue.h>
+#include <rg/Entities.h>
+#include <rg/GpuTimer.h>
+#include <rg/ShaderVariants.h>
+#include <rg/ProgramCache.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
-
-void set_light_bulb(Model &lightModel, Shader &lightShader, glm::vec3 &pointLightPositions, float angle,
-                    const glm::vec3 &translation_vec);
-
-void set_spot_light(Shader &shader, Camera &camera);
-
-void set_point_light(Shader &objectShader, glm::vec3 &point_light_position, int i, float point_light_linear,
+#include <memory>
+#include <thread>
+#include <vector>
+
+// what a Renderable draws; renderables are sorted by it, so a frame's draws come grouped
+enum Drawable {
+    DRAW_CUBE,
+    DRAW_FLOOR,
+    DRAW_BULB,
+    DRAW_TABLE,
+    DRAW_CHAIR,
+    DRAW_BENCH,
+    DRAW_VASE,
+    DRAWABLE_COUNT
+};
+
+// feature bits of the lit programs' variants, see ShaderVariants
+const unsigned int LIGHTING_SPOT_LIGHT = 1;
+// and of the screen quad's
+const unsigned int SCREEN_GRAYSCALE = 1;
+const unsigned int SCREEN_INVERSION = 2;
+
+// a visible renderable as the render thread needs it, copied out once the simulation is done with it
+struct PacketDraw {
+    unsigned int drawable;
+    unsigned int occlusion; // OcclusionQueries object or NO_OCCLUSION
+    glm::mat4 world;
+    AABB worldBounds;
+    unsigned int lights;    // light list
+};
+
+// Everything the render thread draws a frame from. The simulation thread fills it in and hands
+// it over, after that neither thread shares anything the other writes.
+struct FramePacket {
+    CameraBlock camera;
+    LightsBlock lights = LightsBlock(); // point lights without an entity stay black
+    MaterialBlock material;
+    Frustum frustum;
+    std::vector<PacketDraw> draws; // in the order of the renderables, so grouped by drawable
+    int viewportWidth = 0;
+    int viewportHeight = 0;
+    bool grayscale = false;
+    bool inversion = false;
+    bool spotLight = false;
+    bool gpuCulling = false;
+    bool depthPrePass = false;
+    bool printStats = false;
+    SoftwareOcclusionStats softwareOcclusion;
+    LightCullingStats lightCulling;
+    std::size_t visibleCount = 0;
+    std::size_t bvhNodeCount = 0;
+    std::size_t updatedCount = 0;
+    std::size_t sceneNodeCount = 0;
+    std::size_t entityCount = 0;
+};
+
+void batchTransforms(const PacketDraw *draws, unsigned int count, const OcclusionQueries &occlusion,
+                     const glm::vec3 &viewPos, bool impostors, std::vector<glm::mat4> &meshTransforms,
+                     std::vector<unsigned int> &meshLights, std::vector<ImpostorInstance> &impostorInstances);
+
+void printScenePassTimes(const GpuTimer &prePass, const GpuTimer &withPrePass, const GpuTimer &withoutPrePass);
+
+void set_spot_light(SpotLightBlock &spotLight, Camera &camera);
+
+void set_point_light(PointLightBlock &pointLight, const glm::vec3 &point_light_position, float point_light_linear,
                      float point_light_quadratic);
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
@@ -28,15 +110,25 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod);
 
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
+
 void processInput(GLFWwindow *window);
 
-void renderQuad();
+unsigned int floorQuadVAO();
 
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 float heightScale = 0.03;
+// beyond this distance chairs and benches are drawn as impostors, which fade in over the last part of it
+const float impostorDistance = 30.0f;
+const float impostorFade = 5.0f;
+// frames the simulation may be ahead of the render thread, --queue-depth N on the command line
+unsigned int frameQueueDepth = 2;
+// framebuffer size, the render thread sets the viewport from it
+int windowWidth = SCR_WIDTH;
+int windowHeight = SCR_HEIGHT;
 
 // camera
 Camera camera(glm::vec3(0.0f, 1.0f, 12.0f));
@@ -50,8 +142,25 @@ float lastFrame = 0.0f;
 bool isSpotlightActivated = false;
 bool grayscale = false;    // grayscale
 bool inversion = false;    // inversion
+bool printRenderStats = false;
+bool pickRequested = false;
+bool gpuCulling = true;
+bool depthPrePass = false;
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--queue-depth") == 0 && i + 1 < argc) {
+            unsigned long depth = std::strtoul(argv[++i], nullptr, 10);
+            if (depth > 0) {
+                frameQueueDepth = (unsigned int) depth;
+            } else {
+                std::cout << "--queue-depth needs a whole number of frames above 0, keeping " << frameQueueDepth << std::endl;
+            }
+        } else {
+            std::cout << "unknown argument " << argv[i] << ", usage: " << argv[0] << " [--queue-depth frames]" << std::endl;
+        }
+    }
 
-int main() {
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -72,6 +181,7 @@ int main() {
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
 
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -79,16 +189,39 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // GL 4.x features are optional, the renderer falls back to 3.3 paths without them
+    GLFeatures::current().load((GLADloadproc) glfwGetProcAddress);
+    // linked programs are kept next to the impostor bakes and reused while sources and driver match
+    ProgramCache::current().setDirectory(FileSystem::getPath("resources/cache"));
 
 
-    glEnable(GL_DEPTH_TEST);
+    // every bind and enable goes through the state cache, which drops redundant calls
+    GLState &gl = GLState::current();
+    gl.enable(GL_DEPTH_TEST);
 
     // shaders
-    Shader objectShader("resources/shaders/object.vs", "resources/shaders/object.fs");
     Shader lightShader("resources/shaders/light_source.vs", "resources/shaders/light_source.fs");
-    Shader screenShader("resources/shaders/screen.vs", "resources/shaders/screen.fs");
     Shader vegetationShader("resources/shaders/vegetationShader.vs", "resources/shaders/vegetationShader.fs");
-    Shader parallaxShader("resources/shaders/parallax_mapping.vs", "resources/shaders/parallax_mapping.fs");
+    Shader occlusionBoxShader("resources/shaders/occlusion_box.vs", "resources/shaders/occlusion_box.fs");
+    Shader impostorBakeShader("resources/shaders/impostor_bake.vs", "resources/shaders/impostor_bake.fs");
+    Shader depthPrePassShader("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs");
+    // lit programs and the screen quad come in variants without the code of disabled features.
+    // The lights block is sized by the same constant as LightsBlock.
+    const std::string lightingDefines = "#define NR_POINT_LIGHTS " + std::to_string(NR_POINT_LIGHTS) + "\n";
+    const std::vector<std::string> lightingFeatures = {"SPOT_LIGHT"};
+    ShaderVariants objectShaders("resources/shaders/object.vs", "resources/shaders/object.fs", lightingFeatures,
+                                 lightingDefines);
+    ShaderVariants parallaxShaders("resources/shaders/parallax_mapping.vs", "resources/shaders/parallax_mapping.fs",
+                                   lightingFeatures, lightingDefines);
+    ShaderVariants impostorShaders("resources/shaders/impostor.vs", "resources/shaders/impostor.fs", lightingFeatures,
+                                   lightingDefines);
+    // batched furniture reads its textures from texture arrays, through bindless handles if available
+    ShaderVariants batchShaders("resources/shaders/object_batch.vs",
+                                GLFeatures::current().bindlessTexture ? "resources/shaders/object_batch_bindless.fs"
+                                                                      : "resources/shaders/object_batch.fs",
+                                lightingFeatures, lightingDefines);
+    ShaderVariants screenShaders("resources/shaders/screen.vs", "resources/shaders/screen.fs",
+                                 {"GRAYSCALE", "INVERSION"});
 
     // models
     Model tableModel(FileSystem::getPath("resources/objects/dining_table/table.obj"));
@@ -97,9 +230,155 @@ int main() {
     Model chairModel(FileSystem::getPath("resources/objects/chair/Soborg_3050.obj"));
     Model benchModel(FileSystem::getPath("resources/objects/bench/odesd2_B1_obj.obj"));
 
+    // furniture shares one program, so its meshes are drawn together with multi-draw indirect
+    MultiDrawBatch modelBatch;
+    tableModel.AddTo(modelBatch);
+    vaseModel.AddTo(modelBatch);
+    chairModel.AddTo(modelBatch);
+    benchModel.AddTo(modelBatch);
+
+    // far away chairs and benches are quads showing baked views, the bakes are cached across runs
+    Material::setSamplers(impostorBakeShader, "texture_", "1");
+    Impostor chairImpostor(chairModel, impostorBakeShader, FileSystem::getPath("resources/cache"));
+    Impostor benchImpostor(benchModel, impostorBakeShader, FileSystem::getPath("resources/cache"));
+
+    // with compute shaders the batch is culled on the GPU, against the frustum and last frame's depth
+    std::unique_ptr<ComputeShader> cullShader, hiZShader;
+    HiZBuffer hiZ;
+    if (GLFeatures::current().computeShader) {
+        cullShader.reset(new ComputeShader("resources/shaders/cull_batch.comp"));
+        hiZShader.reset(new ComputeShader("resources/shaders/hiz_downsample.comp"));
+    }
+
+    // where everything stands; the lamps are mounts with a swinging bulb as child, so only the
+    // bulbs' local transforms change per frame. The BVH over the nodes culls whole objects
+    // before the batch culls single meshes, and answers the picking ray.
+    SceneGraph scene;
+    AABB cubeBounds;
+    cubeBounds.extend(glm::vec3(-0.5f));
+    cubeBounds.extend(glm::vec3(0.5f));
+    unsigned int cubeNode = scene.addNode("cube", SCENE_NO_PARENT,
+                                          glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.07f, 0.0f)),
+                                                     glm::vec3(1.2f)));
+    scene.setBounds(cubeNode, cubeBounds);
+
+    unsigned int tableNode = scene.addNode("table", SCENE_NO_PARENT,
+                                           glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -5.0f, 0.0f)),
+                                                      glm::vec3(4.6f)));
+    scene.setBounds(tableNode, tableModel.Bounds());
+
+    unsigned int chairNodes[2], benchNodes[2], vaseNodes[2], lampNodes[2], bulbNodes[2];
+    for (int i = 0; i < 2; i++) {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(i * 8.0f - 4.0f, -5.0f, 0.0f));
+        model = glm::rotate(model, glm::radians((float) ((1 - i) * 180.0 - 90.0)), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(4.6f, 4.6f, 4.6f));
+        chairNodes[i] = scene.addNode("chair", SCENE_NO_PARENT, model);
+        scene.setBounds(chairNodes[i], chairModel.Bounds());
+
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.0f, -5.0f, i * 8.0f - 4.0f));
+        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.04f, 0.04f, 0.05f));
+        benchNodes[i] = scene.addNode("bench", SCENE_NO_PARENT, model);
+        scene.setBounds(benchNodes[i], benchModel.Bounds());
+
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(i * 5.0f - 2.5f, -1.67f, 2.0));
+        model = glm::scale(model, glm::vec3(40.0f, 40.0f, 40.0f));
+        vaseNodes[i] = scene.addNode("vase", SCENE_NO_PARENT, model);
+        scene.setBounds(vaseNodes[i], vaseModel.Bounds());
+
+        // the bulb swings around the mount's origin
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.0f, 2.0f, i * 2.0f - 1.0f));
+        model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
+        model = glm::translate(model, glm::vec3(0.0f, 1.32f, 0.0f));
+        lampNodes[i] = scene.addNode("lamp", SCENE_NO_PARENT, model);
+        bulbNodes[i] = scene.addNode("light", lampNodes[i]);
+        scene.setBounds(bulbNodes[i], lightModel.Bounds());
+    }
+
+    glm::mat4 floorTransform = glm::mat4(1.0f);
+    floorTransform = glm::translate(floorTransform, glm::vec3(0.0f, -5.0f, 0.0f));
+    floorTransform = glm::rotate(floorTransform, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    floorTransform = glm::scale(floorTransform, glm::vec3(15.0f));
+    AABB floorBounds;
+    floorBounds.extend(glm::vec3(-1.0f, -1.0f, 0.0f));
+    floorBounds.extend(glm::vec3(1.0f, 1.0f, 0.0f));
+    unsigned int floorNode = scene.addNode("floor", SCENE_NO_PARENT, floorTransform);
+    scene.setBounds(floorNode, floorBounds);
+
+    // large objects are drawn into a small depth buffer on the CPU, everything behind them is
+    // dropped before submission. The table top is a thin slab under the top of the table's box,
+    // inset a little so it stays inside the real top; models can bring their own occluder meshes.
+    struct SceneOccluder {
+        unsigned int node;
+        OccluderMesh mesh;
+    };
+    std::vector<SceneOccluder> occluders;
+    occluders.push_back({cubeNode, OccluderMesh::box(cubeBounds)});
+    AABB tableTop = tableModel.Bounds();
+    glm::vec3 tableSize = tableTop.max - tableTop.min;
+    tableTop.min += glm::vec3(tableSize.x * 0.05f, tableSize.y * 0.96f, tableSize.z * 0.05f);
+    tableTop.max -= glm::vec3(tableSize.x * 0.05f, 0.0f, tableSize.z * 0.05f);
+    occluders.push_back({tableNode, OccluderMesh::box(tableTop)});
+    OccluderMesh floorOccluder;
+    floorOccluder.positions = {glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f),
+                               glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 1.0f, 0.0f)};
+    floorOccluder.indices = {0, 1, 2, 0, 2, 3};
+    occluders.push_back({floorNode, floorOccluder});
+    struct PlacedModel {
+        const Model *model;
+        const unsigned int *nodes;
+        unsigned int count;
+    };
+    const PlacedModel placedModels[] = {{&tableModel, &tableNode, 1}, {&chairModel, chairNodes, 2},
+                                        {&benchModel, benchNodes, 2}, {&vaseModel, vaseNodes, 2}};
+    for (const PlacedModel &placed : placedModels) {
+        for (const OccluderMesh &mesh : placed.model->occluders) {
+            for (unsigned int i = 0; i < placed.count; i++) {
+                occluders.push_back({placed.nodes[i], mesh});
+            }
+        }
+    }
+    SoftwareOcclusion softwareOcclusion;
+
+    // small objects that are often hidden behind the table or the cube get occlusion queries.
+    // Both bulbs are drawn by one instanced draw, so they share a query over their joint box.
+    OcclusionQueries occlusion;
+    unsigned int cubeOcclusion = occlusion.add();
+    unsigned int bulbsOcclusion = occlusion.add();
+    unsigned int vaseOcclusion[2] = {occlusion.add(), occlusion.add()};
+
+    // every drawn object is an entity: its scene node, what it draws and the light it carries.
+    // A frame's draws and lights are built by walking the component pools.
+    Entities entities;
+    auto addRenderable = [&](unsigned int node, Drawable drawable, unsigned int occlusionObject) {
+        Entity entity = entities.create();
+        entities.transforms().add(entity, {node});
+        entities.renderables().add(entity, {(unsigned int) drawable, occlusionObject});
+        return entity;
+    };
+    addRenderable(cubeNode, DRAW_CUBE, cubeOcclusion);
+    addRenderable(tableNode, DRAW_TABLE, NO_OCCLUSION);
+    addRenderable(floorNode, DRAW_FLOOR, NO_OCCLUSION);
+    for (int i = 0; i < 2; i++) {
+        addRenderable(chairNodes[i], DRAW_CHAIR, NO_OCCLUSION);
+        addRenderable(benchNodes[i], DRAW_BENCH, NO_OCCLUSION);
+        addRenderable(vaseNodes[i], DRAW_VASE, vaseOcclusion[i]);
+        // the light sits a bit below the bulb's origin
+        Entity bulb = addRenderable(bulbNodes[i], DRAW_BULB, bulbsOcclusion);
+        entities.pointLights().add(bulb, {glm::vec3(0.0f, 0.2f, 0.0f), 0.09f, 0.032f});
+    }
+    entities.renderables().sort([](const Renderable &a, const Renderable &b) {
+        return a.drawable < b.drawable;
+    });
+    entities.transforms().sortLike(entities.renderables());
+
 
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_FRONT);
+    gl.enable(GL_CULL_FACE);
+    gl.cullFace(GL_FRONT);
 
     // screen vertexes
     float quadVertices[] = {
@@ -158,22 +437,11 @@ int main() {
             -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f
     };
 
-    float transparentVertices[] = {
-            // positions         // texture Coords (swapped y coordinates because texture is flipped upside down)
-            0.0f, 0.5f, 0.0f, 0.0f, 0.0f,
-            0.0f, -0.5f, 0.0f, 0.0f, 1.0f,
-            1.0f, -0.5f, 0.0f, 1.0f, 1.0f,
-
-            0.0f, 0.5f, 0.0f, 0.0f, 0.0f,
-            1.0f, -0.5f, 0.0f, 1.0f, 1.0f,
-            1.0f, 0.5f, 0.0f, 1.0f, 0.0f
-    };
-
 
     unsigned int cubeVAO, cubeVBO;
     glGenVertexArrays(1, &cubeVAO);
     glGenBuffers(1, &cubeVBO);
-    glBindVertexArray(cubeVAO);
+    gl.bindVertexArray(cubeVAO);
     glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
     // position attribute
@@ -185,12 +453,15 @@ int main() {
     // texture coord attribute
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (6 * sizeof(float)));
     glEnableVertexAttribArray(2);
+    // per-instance model matrix, object.vs reads it instead of a model uniform. Each cube's draw
+    // item carries its own upload, the queue points the VAO at it when the cube is drawn.
+    InstanceBuffer cubeInstances;
 
     // setup screen VAO
     unsigned int quadVAO, quadVBO;
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    gl.bindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -198,29 +469,22 @@ int main() {
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *) (2 * sizeof(float)));
 
-    unsigned int transparentVAO, transparentVBO;
-    glGenVertexArrays(1, &transparentVAO);
-    glGenBuffers(1, &transparentVBO);
-    glBindVertexArray(transparentVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *) (3 * sizeof(float)));
-    glBindVertexArray(0);
+    // vegetation, blades are generated in the vertex shader
+    FoliageRenderer foliage;
+    std::vector<FoliageClump> clumps;
+    clumps.push_back({glm::vec3(0.0f, 0.03f, 0.0f), 0.45f, 2, 32});
+    foliage.setClumps(clumps);
 
     // configure MSAA framebuffer
     // --------------------------
     unsigned int framebuffer;
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    gl.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
     // create a multisampled color attachment texture
     unsigned int textureColorBufferMultiSampled;
     glGenTextures(1, &textureColorBufferMultiSampled);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
+    gl.bindTexture(0, GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
     glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGB, SCR_WIDTH, SCR_HEIGHT, GL_TRUE);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE,
                            textureColorBufferMultiSampled, 0);
     // create a (also multisampled) renderbuffer object for depth and stencil attachments
@@ -233,236 +497,456 @@ int main() {
 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl.bindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    screenShader.setInt("screenTexture", 0);
     vegetationShader.use();
     vegetationShader.setInt("Texture", 2);
 
 
-    unsigned int floorDiffTexture = TextureFromFile("bricks_diffuse.jpg", "resources/objects/floor");
-    unsigned int floorNormTexture = TextureFromFile("bricks_normal.jpg", "resources/objects/floor");
-    unsigned int floorHeightTexture = TextureFromFile("bricks_bump.jpg", "resources/objects/floor");
-    unsigned int cubeDiffTexture = TextureFromFile("Brick_wall_002_COLOR.jpg", "resources/objects/cube");
-    unsigned int cubeSpecTexture = TextureFromFile("Brick_wall_002_SPEC.jpg", "resources/objects/cube");
-    unsigned int vegetationTexture = TextureFromFile("vegetation.png", "resources/objects/vegetation");
+    TextureHandle floorDiffTexture = LoadTexture("bricks_diffuse.jpg", "resources/objects/floor");
+    TextureHandle floorNormTexture = LoadTexture("bricks_normal.jpg", "resources/objects/floor");
+    TextureHandle floorHeightTexture = LoadTexture("bricks_bump.jpg", "resources/objects/floor");
+    TextureHandle cubeDiffTexture = LoadTexture("Brick_wall_002_COLOR.jpg", "resources/objects/cube");
+    TextureHandle cubeSpecTexture = LoadTexture("Brick_wall_002_SPEC.jpg", "resources/objects/cube");
+    TextureHandle vegetationTexture = LoadTexture("vegetation.png", "resources/objects/vegetation");
+    // draw items refer to the cube and the floor quad by handle
+    VertexArrayInfo cubeInfo, floorInfo;
+    cubeInfo.count = 36;
+    floorInfo.count = 6;
+    VertexArrayHandle cubeVertexArray = Resources::current().vertexArrays().add(cubeVAO, cubeInfo);
+    VertexArrayHandle floorVertexArray = Resources::current().vertexArrays().add(floorQuadVAO(), floorInfo);
+
+    // shared uniform blocks, every program reads camera/lights/material from the same binding points
+    UniformBuffer<CameraBlock> cameraBlock(CAMERA_BLOCK_BINDING);
+    UniformBuffer<LightsBlock> lightsBlock(LIGHTS_BLOCK_BINDING);
+    UniformBuffer<MaterialBlock> materialBlock(MATERIAL_BLOCK_BINDING);
+    auto bindUniformBlocks = [](Shader &shader) {
+        shader.bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+        shader.bindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+        shader.bindUniformBlock("MaterialParams", MATERIAL_BLOCK_BINDING);
+    };
+    Shader *blockShaders[] = {&lightShader, &vegetationShader, &depthPrePassShader};
+    for (Shader *shader : blockShaders) {
+        bindUniformBlocks(*shader);
+    }
 
-    parallaxShader.use();
-    parallaxShader.setInt("material.diffuseMap", 0);
-    parallaxShader.setInt("material.normalMap", 1);
-    parallaxShader.setInt("material.depthMap", 2);
+    // model textures sit on fixed units per type, see Material. Every variant is set up once when it is compiled.
+    Material::setSamplers(lightShader, "texture_", "1");
+    objectShaders.setup([&](Shader &shader) {
+        bindUniformBlocks(shader);
+        Material::setSamplers(shader, "material.");
+    });
+    batchShaders.setup([&](Shader &shader) {
+        bindUniformBlocks(shader);
+        shader.use();
+        shader.setInt("diffuseArray", 0);
+        shader.setInt("specularArray", 1);
+    });
+    impostorShaders.setup([&](Shader &shader) {
+        bindUniformBlocks(shader);
+        shader.use();
+        shader.setInt("colorAtlas", 0);
+        shader.setInt("normalDepthAtlas", 1);
+    });
+    parallaxShaders.setup([&](Shader &shader) {
+        bindUniformBlocks(shader);
+        shader.use();
+        shader.setInt("material.diffuseMap", 0);
+        shader.setInt("material.normalMap", 1);
+        shader.setInt("material.depthMap", 2);
+    });
+    screenShaders.setup([](Shader &shader) {
+        shader.use();
+        shader.setInt("screenTexture", 0);
+    });
+    // every state the keys can reach is compiled now, toggling a feature never waits for the compiler
+    ShaderVariants *litShaders[] = {&objectShaders, &parallaxShaders, &impostorShaders, &batchShaders};
+    for (ShaderVariants *shaders : litShaders) {
+        shaders->prewarm({0, LIGHTING_SPOT_LIGHT});
+    }
+    screenShaders.prewarm({0, SCREEN_GRAYSCALE, SCREEN_INVERSION});
+    // the uniforms the render queue sets per draw, looked up once for each lighting variant
+    struct LitLocations {
+        int objectLights;
+        int parallaxModel;
+        int parallaxLights;
+    };
+    LitLocations litLocations[2];
+    for (unsigned int lighting : {0u, LIGHTING_SPOT_LIGHT}) {
+        Shader &objectShader = objectShaders.variant(lighting);
+        Shader &parallaxShader = parallaxShaders.variant(lighting);
+        litLocations[lighting] = {objectShader.getUniformLocation("lights"), parallaxShader.getUniformLocation("model"),
+                                  parallaxShader.getUniformLocation("lights")};
+    }
+    std::cout << "shader programs:  " << ProgramCache::current().stats() << std::endl;
+
+
+    // draws of a frame, sorted by program, material and depth before execution
+    RenderQueue renderQueue;
+
+    // The render thread owns the GL context from here on and draws the packets this thread
+    // builds: it submits frame N while the next iteration simulates and culls frame N + 1.
+    FrameQueue<FramePacket> frames(frameQueueDepth);
+    glfwMakeContextCurrent(NULL);
+    std::thread renderThread([&]() {
+        glfwMakeContextCurrent(window);
+        int viewportWidth = SCR_WIDTH;
+        int viewportHeight = SCR_HEIGHT;
+        // batched drawables by model, and their impostors for those that have them
+        Model *batchModels[DRAWABLE_COUNT] = {};
+        batchModels[DRAW_TABLE] = &tableModel;
+        batchModels[DRAW_CHAIR] = &chairModel;
+        batchModels[DRAW_BENCH] = &benchModel;
+        batchModels[DRAW_VASE] = &vaseModel;
+        Impostor *batchImpostors[DRAWABLE_COUNT] = {};
+        batchImpostors[DRAW_CHAIR] = &chairImpostor;
+        batchImpostors[DRAW_BENCH] = &benchImpostor;
+        std::vector<glm::mat4> transforms;
+        std::vector<unsigned int> lights;
+        std::vector<ImpostorInstance> impostors;
+        // GPU time of the scene's draws, shaded either after a depth pre-pass or directly
+        GpuTimer prePassTimer;
+        GpuTimer scenePassTimers[2];
+        FramePacket frame;
+        while (frames.pop(frame)) {
+            FrameQueue<FramePacket>::Clock::time_point renderStart = FrameQueue<FramePacket>::Clock::now();
+            if (frame.viewportWidth != viewportWidth || frame.viewportHeight != viewportHeight) {
+                viewportWidth = frame.viewportWidth;
+                viewportHeight = frame.viewportHeight;
+                glViewport(0, 0, viewportWidth, viewportHeight);
+            }
+
+            // draw scene as normal in multisampled buffers
+            gl.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            gl.enable(GL_DEPTH_TEST);
+
+            // the smallest variants covering this frame's state, and their uniform locations
+            unsigned int lighting = frame.spotLight ? LIGHTING_SPOT_LIGHT : 0;
+            Shader &objectShader = objectShaders.variant(lighting);
+            Shader &parallaxShader = parallaxShaders.variant(lighting);
+            Shader &impostorShader = impostorShaders.variant(lighting);
+            Shader &batchShader = batchShaders.variant(lighting);
+            const LitLocations &locations = litLocations[lighting];
+
+            cameraBlock.data = frame.camera;
+            cameraBlock.upload();
+            materialBlock.data = frame.material;
+            materialBlock.upload();
+            lightsBlock.data = frame.lights;
+            lightsBlock.upload();
+            occlusion.begin();
+
+            const glm::vec3 &viewPos = frame.camera.viewPos;
+            renderQueue.begin(frame.camera.view);
+            modelBatch.begin(frame.frustum);
+
+            // the draws come grouped by drawable, each group is submitted as a whole
+            unsigned int impostorsDrawn = 0;
+            for (std::size_t begin = 0, end; begin < frame.draws.size(); begin = end) {
+                unsigned int drawable = frame.draws[begin].drawable;
+                for (end = begin + 1; end < frame.draws.size() && frame.draws[end].drawable == drawable; ++end) {
+                }
+                const PacketDraw *draws = &frame.draws[begin];
+                unsigned int count = end - begin;
+                switch (drawable) {
+                    case DRAW_CUBE:
+                        //cube (face culling)
+                        for (unsigned int i = 0; i < count; i++) {
+                            if (occlusion.hidden(draws[i].occlusion)) {
+                                continue;
+                            }
+                            const glm::mat4 &model = draws[i].world;
+                            DrawItem cubeItem;
+                            cubeItem.instances = cubeInstances.upload(&model, 1);
+                            cubeItem.program = objectShader.handle;
+                            cubeItem.vao = cubeVertexArray;
+                            cubeItem.textures[0] = cubeDiffTexture;
+                            cubeItem.textures[1] = cubeSpecTexture;
+                            cubeItem.count = 36;
+                            cubeItem.cullFace = true;
+                            cubeItem.lightsLocation = locations.objectLights;
+                            cubeItem.lights = draws[i].lights;
+                            cubeItem.occlusionQuery = occlusion.conditionQuery(draws[i].occlusion);
+                            renderQueue.submit(OPAQUE_PASS, cubeItem, glm::vec3(model[3]));
+                        }
+                        break;
+                    case DRAW_FLOOR:
+                        //floor (parallax mapping)
+                        for (unsigned int i = 0; i < count; i++) {
+                            const glm::mat4 &model = draws[i].world;
+                            DrawItem floorItem;
+                            floorItem.program = parallaxShader.handle;
+                            floorItem.vao = floorVertexArray;
+                            floorItem.textures[0] = floorDiffTexture;
+                            floorItem.textures[1] = floorNormTexture;
+                            floorItem.textures[2] = floorHeightTexture;
+                            floorItem.count = 6;
+                            floorItem.modelLocation = locations.parallaxModel;
+                            floorItem.transform = renderQueue.addTransform(model);
+                            floorItem.lightsLocation = locations.parallaxLights;
+                            floorItem.lights = draws[i].lights;
+                            // parallax_mapping.fs discards texels shifted off the quad
+                            floorItem.ownDepth = true;
+                            renderQueue.submit(OPAQUE_PASS, floorItem, glm::vec3(model[3]));
+                        }
+                        break;
+                    case DRAW_BULB:
+                        // light, the bulbs are one instanced draw under their joint query
+                        if (!occlusion.hidden(draws[0].occlusion)) {
+                            transforms.clear();
+                            for (unsigned int i = 0; i < count; i++) {
+                                transforms.push_back(draws[i].world);
+                            }
+                            lightModel.Submit(renderQueue, OPAQUE_PASS, lightShader, transforms.data(), count,
+                                              occlusion.conditionQuery(draws[0].occlusion));
+                        }
+                        break;
+                    default:
+                        // furniture, far chairs and benches are impostors
+                        batchTransforms(draws, count, occlusion, viewPos, batchImpostors[drawable] != nullptr,
+                                        transforms, lights, impostors);
+                        batchModels[drawable]->Submit(modelBatch, transforms.data(), transforms.size(), lights.data());
+                        if (batchImpostors[drawable]) {
+                            batchImpostors[drawable]->Submit(renderQueue, OPAQUE_PASS, impostorShader,
+                                                             impostors.data(), impostors.size(), viewPos);
+                            impostorsDrawn += impostors.size();
+                        }
+                        break;
+                }
+            }
+
+            //vegetation (blending)
+            DrawItem vegetationItem = foliage.drawItem();
+            vegetationItem.program = vegetationShader.handle;
+            vegetationItem.textures[2] = vegetationTexture;
+            renderQueue.submit(TRANSPARENT_PASS, vegetationItem, clumps[0].position);
+
+            batchShader.use();
+            modelBatch.setGpuCulling(frame.gpuCulling ? cullShader.get() : nullptr, &hiZ);
+            modelBatch.prepare();
+
+            // with the pre-pass the opaque depth is laid down first by a position-only program,
+            // then the shading pass only runs the fragment shaders of the surfaces that stay visible
+            if (frame.depthPrePass) {
+                prePassTimer.begin();
+                gl.colorMask(false);
+                depthPrePassShader.use();
+                modelBatch.draw(false);
+                renderQueue.executeDepthPrePass(depthPrePassShader.handle);
+                gl.colorMask(true);
+                prePassTimer.end();
+            }
+            GpuTimer &scenePassTimer = scenePassTimers[frame.depthPrePass];
+            scenePassTimer.begin();
+            batchShader.use();
+            if (frame.depthPrePass) {
+                gl.depthFunc(GL_EQUAL);
+                gl.depthMask(false);
+            }
+            modelBatch.draw();
+            if (frame.depthPrePass) {
+                gl.depthFunc(GL_LESS);
+                gl.depthMask(true);
+            }
+            renderQueue.execute();
+            scenePassTimer.end();
+
+            // test the small objects' boxes against this frame's depth, the results are used next frame.
+            // Draws sharing a query are next to each other and test their joint box.
+            for (std::size_t i = 0; i < frame.draws.size();) {
+                const PacketDraw &draw = frame.draws[i++];
+                if (draw.occlusion == NO_OCCLUSION) {
+                    continue;
+                }
+                AABB box = draw.worldBounds;
+                for (; i < frame.draws.size() && frame.draws[i].occlusion == draw.occlusion; ++i) {
+                    box.extend(frame.draws[i].worldBounds);
+                }
+                occlusion.query(draw.occlusion, box);
+            }
+            occlusion.issue(occlusionBoxShader, frame.camera.viewProjection, viewPos);
+
+            // depth pyramid of this frame for next frame's occlusion tests
+            if (hiZShader) {
+                hiZ.build(*hiZShader, framebuffer, SCR_WIDTH, SCR_HEIGHT, frame.camera.viewProjection);
+            }
+            if (frame.printStats) {
+                std::cout << "submission order: " << renderQueue.unsortedStats() << std::endl;
+                std::cout << "sorted:           " << renderQueue.executedStats() << std::endl;
+                if (frame.depthPrePass) {
+                    std::cout << "depth pre-pass:   " << renderQueue.prePassStats() << std::endl;
+                }
+                std::cout << "multi-draw:       " << modelBatch.commandCount() << " meshes in "
+                          << modelBatch.drawCallCount() << " draw calls, "
+                          << modelBatch.textureBindCount() << " texture array binds, "
+                          << modelBatch.visibleCount() << " instances visible, " << modelBatch.culledCount() << " culled"
+                          << (modelBatch.gpuCulled() ? " on the GPU" : "")
+                          << (GLFeatures::current().multiDrawIndirect ? "" : " (GL 3.3 fallback)") << std::endl;
+                std::cout << "occlusion:        " << occlusion.stats() << std::endl;
+                std::cout << "CPU occlusion:    " << frame.softwareOcclusion << std::endl;
+                std::cout << "lights:           " << frame.lightCulling << std::endl;
+                std::cout << "impostors:        " << impostorsDrawn << " drawn, atlases "
+                          << (chairImpostor.cached() && benchImpostor.cached() ? "loaded from the cache" : "baked") << std::endl;
+                std::cout << "scene:            " << frame.visibleCount << " objects visible, BVH of "
+                          << frame.bvhNodeCount << " nodes over " << frame.sceneNodeCount << " scene nodes, "
+                          << frame.updatedCount << " transforms updated, " << frame.entityCount << " entities"
+                          << std::endl;
+                unsigned int compiledVariants = 0, possibleVariants = 0;
+                for (const ShaderVariants *shaders : {&objectShaders, &parallaxShaders, &impostorShaders,
+                                                      &batchShaders, &screenShaders}) {
+                    compiledVariants += shaders->compiledCount();
+                    possibleVariants += shaders->variantCount();
+                }
+                std::cout << "shader variants:  " << compiledVariants << " of " << possibleVariants
+                          << " compiled, drawing with spot light " << (frame.spotLight ? "on" : "off") << std::endl;
+                std::cout << "shader programs:  " << ProgramCache::current().stats() << std::endl;
+                std::cout << "stream buffer:    " << StreamBuffer::current().stats() << std::endl;
+                std::cout << "state cache:      " << gl.counters() << std::endl;
+                std::cout << "threads:          " << frames.timings() << ", queue depth " << frames.depth() << std::endl;
+                printScenePassTimes(prePassTimer, scenePassTimers[1], scenePassTimers[0]);
+                frames.resetTimings();
+                prePassTimer.reset();
+                scenePassTimers[0].reset();
+                scenePassTimers[1].reset();
+            }
+
+            // 2. now render quad with scene's visuals as its texture image
+            gl.bindFramebuffer(GL_FRAMEBUFFER, 0);
+            glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            gl.disable(GL_DEPTH_TEST);
+
+            // draw Screen quad, grayscale and inversion exclude each other
+            Shader &screenShader = screenShaders.variant(frame.grayscale ? SCREEN_GRAYSCALE
+                                                                         : frame.inversion ? SCREEN_INVERSION : 0);
+            screenShader.use();
+            gl.bindVertexArray(quadVAO);
+            gl.bindTexture(0, GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled); // use multisampled texture
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            // this frame's streamed data stays untouched until the GPU is done with it
+            StreamBuffer::current().endFrame();
 
+            glfwSwapBuffers(window);
+            frames.finished(FrameQueue<FramePacket>::milliseconds(renderStart, FrameQueue<FramePacket>::Clock::now()));
+        }
+        glfwMakeContextCurrent(NULL);
+    });
 
-    glm::vec3 pointLightPositions[2];
+    // this thread handles input, moves the scene and decides what is visible
+    LightCuller lightCuller;
     while (!glfwWindowShouldClose(window)) {
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        FrameQueue<FramePacket>::Clock::time_point simulationStart = FrameQueue<FramePacket>::Clock::now();
 
         processInput(window);
 
-        // draw scene as normal in multisampled buffers
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-
-
+        FramePacket frame;
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT,
                                                 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
-
-
-        //cube (face culling)
-        glm::mat4 model = glm::mat4(1.0f);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeDiffTexture);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, cubeSpecTexture);
-
-        glEnable(GL_CULL_FACE);
-
-        objectShader.use();
-        glBindVertexArray(cubeVAO);
-        objectShader.setMat4("projection", projection);
-        objectShader.setMat4("view", view);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, -1.07f, 0.0f));
-        model = glm::scale(model, glm::vec3(1.2f, 1.2f, 1.2f));
-
-        objectShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        glDisable(GL_CULL_FACE);
-
-        // light
-        float pointLightLinear = 0.09;
-        float pointLightQuadratic = 0.032;
-        lightShader.use();
-        lightShader.setMat4("projection", projection);
-        lightShader.setMat4("view", view);
-
-        set_light_bulb(lightModel, lightShader, pointLightPositions[0],
-                       glm::radians((float) (30.0 * sin(2 + 2 * glfwGetTime()))),
-                       glm::vec3(0.0f, 2.0f, -1.0f));
-        set_light_bulb(lightModel, lightShader, pointLightPositions[1],
-                       glm::radians((float) (30.0 * sin(2 + 2 * glfwGetTime()))),
-                       glm::vec3(0.0f, 2.0f, 1.0f));
-
-        objectShader.use();
-
-
-        // point light 1
-        set_point_light(objectShader, pointLightPositions[0], 0, pointLightLinear, pointLightQuadratic);
-        // point light 2
-        set_point_light(objectShader, pointLightPositions[1], 1, pointLightLinear, pointLightQuadratic);
-        // spotLight
-        set_spot_light(objectShader, camera);
-
-        // table
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, -5.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(4.6f, 4.6f, 4.6f));
-        objectShader.setMat4("model", model);
-        tableModel.Draw(objectShader);
-
-        //chair
+        glm::mat4 viewProjection = projection * view;
+        frame.camera.projection = projection;
+        frame.camera.view = view;
+        frame.camera.viewPos = camera.Position;
+        frame.camera.padding = 0.0f;
+        frame.camera.viewProjection = viewProjection;
+
+        frame.material.shininess = 128.0f;
+        frame.material.heightScale = heightScale; // adjust with Q and R keys
+
+        // swing the bulbs, then cull the scene's objects as a whole
+        float swing = glm::radians((float) (30.0 * sin(2 + 2 * glfwGetTime())));
         for (int i = 0; i < 2; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(i * 8.0f - 4.0f, -5.0f, 0.0f));
-            model = glm::rotate(model, glm::radians((float) ((1 - i) * 180.0 - 90.0)), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(4.6f, 4.6f, 4.6f));
-            objectShader.setMat4("model", model);
-            chairModel.Draw(objectShader);
+            glm::mat4 model = glm::rotate(glm::mat4(1.0f), swing, glm::vec3(0.0f, 0.0f, 1.0f));
+            scene.setLocal(bulbNodes[i], glm::translate(model, glm::vec3(0.0f, -1.32f, 0.0f)));
         }
-
-        //bench
-        for (int i = 0; i < 2; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, -5.0f, i * 8.0f - 4.0f));
-            model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.04f, 0.04f, 0.05f));
-            objectShader.setMat4("model", model);
-            benchModel.Draw(objectShader);
+        scene.update();
+        Frustum frustum = Frustum::fromMatrix(viewProjection);
+        scene.cull(frustum);
+        softwareOcclusion.begin(viewProjection);
+        for (const SceneOccluder &occluder : occluders) {
+            if (scene.visible(occluder.node)) {
+                softwareOcclusion.addOccluder(occluder.mesh, scene.world(occluder.node));
+            }
         }
-
-
-        //vase
-        for (int i = 0; i < 2; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(i * 5.0f - 2.5f, -1.67f, 2.0));
-            model = glm::scale(model, glm::vec3(40.0f, 40.0f, 40.0f));
-            objectShader.setMat4("model", model);
-            vaseModel.Draw(objectShader);
+        softwareOcclusion.rasterize();
+        for (unsigned int i = 0; i < scene.size(); i++) {
+            if (scene.visible(i) && scene.hasBounds(i) && !softwareOcclusion.visible(scene.worldBounds(i))) {
+                scene.hide(i);
+            }
         }
 
-
-        //floor (parallax mapping)
-        parallaxShader.use();
-        //set point_light 1
-        parallaxShader.setMat4("projection", projection);
-        parallaxShader.setMat4("view", view);
-        parallaxShader.setVec3("lightPos[0]", pointLightPositions[0]);
-        parallaxShader.setVec3("pointLight[0].position", pointLightPositions[0]);
-        parallaxShader.setVec3("pointLight[0].ambient", 0.1f, 0.1f, 0.1f);
-        parallaxShader.setVec3("pointLight[0].diffuse", 0.8f, 0.8f, 0.8f);
-        parallaxShader.setVec3("pointLight[0].specular", 1.0f, 1.0f, 1.0f);
-        parallaxShader.setFloat("pointLight[0].constant", 1.0f);
-        parallaxShader.setFloat("pointLight[0].linear", pointLightLinear);
-        parallaxShader.setFloat("pointLight[0].quadratic", pointLightQuadratic);
-        //set point_light 2
-        parallaxShader.setMat4("projection", projection);
-        parallaxShader.setMat4("view", view);
-        parallaxShader.setVec3("lightPos[1]", pointLightPositions[0]);
-        parallaxShader.setVec3("pointLight[1].position", pointLightPositions[0]);
-        parallaxShader.setVec3("pointLight[1].ambient", 0.1f, 0.1f, 0.1f);
-        parallaxShader.setVec3("pointLight[1].diffuse", 0.8f, 0.8f, 0.8f);
-        parallaxShader.setVec3("pointLight[1].specular", 1.0f, 1.0f, 1.0f);
-        parallaxShader.setFloat("pointLight[1].constant", 1.0f);
-        parallaxShader.setFloat("pointLight[1].linear", pointLightLinear);
-        parallaxShader.setFloat("pointLight[1].quadratic", pointLightQuadratic);
-
-        //set spot_light
-        parallaxShader.setVec3("spotLight.position", camera.Position);
-        parallaxShader.setVec3("spotLight.direction", camera.Front);
-        if (isSpotlightActivated) {
-            parallaxShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-            parallaxShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-            parallaxShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        } else { // All to 0.
-            parallaxShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-            parallaxShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-            parallaxShader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
+        if (pickRequested) {
+            // the cursor is captured, so the picking ray goes through the middle of the screen
+            unsigned int picked;
+            float distance;
+            if (scene.raycast(camera.Position, camera.Front, picked, distance)) {
+                std::cout << "picked " << scene.name(picked) << " at distance " << distance << std::endl;
+            } else {
+                std::cout << "picked nothing" << std::endl;
+            }
+            pickRequested = false;
         }
-        parallaxShader.setFloat("spotLight.constant", 1.0f);
-        parallaxShader.setFloat("spotLight.linear", 0.1);
-        parallaxShader.setFloat("spotLight.quadratic", 0.01);
-        parallaxShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(2.5f)));
-        parallaxShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(22.0f)));
-
-        parallaxShader.setVec3("viewPos", camera.Position);
-        parallaxShader.setFloat("material.shininess", 128.0f);
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, -5.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(15.0f));
-        parallaxShader.setMat4("model", model);
-        parallaxShader.setVec3("viewPos", camera.Position);
-        parallaxShader.setFloat("heightScale", heightScale); // adjust with Q and R keys
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorDiffTexture);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, floorNormTexture);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, floorHeightTexture);
-        renderQuad();
-
-        //vegetation (blending)
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, vegetationTexture);
-
-        vegetationShader.use();
-        glBindVertexArray(transparentVAO);
-
-        vegetationShader.setMat4("projection", projection);
-        vegetationShader.setMat4("view", view);
-        for (unsigned int i = 0; i < 33; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, 0.03f, 0.0f));
-            model = glm::rotate(model, glm::radians((float) (11.25 * i)), glm::vec3(0.0f, 1.0f, 0.0f));
-            vegetationShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+        // the lights shine whether or not their bulbs are on screen
+        const ComponentPool<PointLight> &pointLights = entities.pointLights();
+        for (std::size_t i = 0; i < pointLights.size() && i < NR_POINT_LIGHTS; i++) {
+            const PointLight &light = pointLights.component(i);
+            unsigned int node = entities.transforms().get(pointLights.entity(i)).node;
+            glm::vec3 position = glm::vec3(scene.world(node) * glm::vec4(light.offset, 1.0f));
+            set_point_light(frame.lights.pointLights[i], position, light.linear, light.quadratic);
         }
-        for (unsigned int i = 0; i < 33; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, 0.48f, 0.0f));
-            model = glm::rotate(model, glm::radians((float) (11.25 * i)), glm::vec3(0.0f, 1.0f, 0.0f));
-            vegetationShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+        // spotLight
+        set_spot_light(frame.lights.spotLight, camera);
+        // every visible object gets only the lights that reach it
+        lightCuller.update(frame.lights);
+
+        frame.frustum = frustum;
+        const ComponentPool<Renderable> &renderables = entities.renderables();
+        frame.draws.reserve(renderables.size());
+        for (std::size_t i = 0; i < renderables.size(); i++) {
+            unsigned int node = entities.transforms().get(renderables.entity(i)).node;
+            if (!scene.visible(node)) {
+                continue;
+            }
+            PacketDraw draw;
+            draw.drawable = renderables.component(i).drawable;
+            draw.occlusion = renderables.component(i).occlusion;
+            draw.world = scene.world(node);
+            draw.worldBounds = scene.worldBounds(node);
+            draw.lights = scene.hasBounds(node) ? lightCuller.lightsFor(draw.worldBounds) : allLights();
+            frame.draws.push_back(draw);
         }
-
-        // 2. now render quad with scene's visuals as its texture image
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_DEPTH_TEST);
-
-        // draw Screen quad
-        screenShader.use();
-        screenShader.setInt("grayscale", grayscale);
-        screenShader.setInt("inversion", inversion);
-        glBindVertexArray(quadVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled); // use multisampled texture
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glEnable(GL_DEPTH_TEST);
-
-        glfwSwapBuffers(window);
+        frame.viewportWidth = windowWidth;
+        frame.viewportHeight = windowHeight;
+        frame.grayscale = grayscale;
+        frame.inversion = inversion;
+        frame.spotLight = isSpotlightActivated;
+        frame.gpuCulling = gpuCulling;
+        frame.depthPrePass = depthPrePass;
+        frame.printStats = printRenderStats;
+        printRenderStats = false;
+        frame.softwareOcclusion = softwareOcclusion.stats();
+        frame.lightCulling = lightCuller.stats();
+        frame.visibleCount = scene.visibleCount();
+        frame.bvhNodeCount = scene.bvhNodeCount();
+        frame.updatedCount = scene.updatedCount();
+        frame.sceneNodeCount = scene.size();
+        frame.entityCount = entities.size();
+
+        double simulationTime = FrameQueue<FramePacket>::milliseconds(simulationStart,
+                                                                      FrameQueue<FramePacket>::Clock::now());
+        frames.push(std::move(frame), simulationTime);
         glfwPollEvents();
     }
 
-
+    frames.close();
+    renderThread.join();
+    glfwMakeContextCurrent(window);
     glfwTerminate();
     return 0;
 }
@@ -470,7 +954,7 @@ int main() {
 unsigned int floorVAO = 0;
 unsigned int floorVBO;
 
-void renderQuad() {
+unsigned int floorQuadVAO() {
     if (floorVAO == 0) {
         // positions
         glm::vec3 pos1(-1.0f, 1.0f, 0.0f);
@@ -547,7 +1031,7 @@ void renderQuad() {
         // configure plane VAO
         glGenVertexArrays(1, &floorVAO);
         glGenBuffers(1, &floorVBO);
-        glBindVertexArray(floorVAO);
+        GLState::current().bindVertexArray(floorVAO);
         glBindBuffer(GL_ARRAY_BUFFER, floorVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(floorVertices), &floorVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -561,56 +1045,90 @@ void renderQuad() {
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void *) (11 * sizeof(float)));
     }
-    glBindVertexArray(floorVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+    return floorVAO;
 }
 
-void set_light_bulb(Model &lightModel, Shader &lightShader, glm::vec3 &pointLightPositions, float angle,
-                    const glm::vec3 &translation_vec) {
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, translation_vec);
-    model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
-    model = glm::translate(model, glm::vec3(0.0f, 1.32f, 0.0f));
-    model = glm::rotate(model, angle, glm::vec3(0.0f, 0.0f, 1.0f));
-    model = glm::translate(model, glm::vec3(0.0f, -1.32f, 0.0f));
-    pointLightPositions = glm::vec3(model * glm::vec4(0.0f, 0.2f, 0.0f, 1.0f));
-    lightShader.setMat4("model", model);
-    lightModel.Draw(lightShader);
+// Transforms and light lists of one batched drawable's draws. Draws whose occlusion query found
+// them hidden are dropped: one multi-draw can't be conditioned per instance, so they are only
+// skipped once the CPU has the result. With impostors the draws are split by their distance from
+// the camera: near ones keep their mesh, far ones are impostors, and in between both are drawn
+// while the impostor dithers in on top of the mesh, so the switch never shows a frame without the object.
+void batchTransforms(const PacketDraw *draws, unsigned int count, const OcclusionQueries &occlusion,
+                     const glm::vec3 &viewPos, bool impostors, std::vector<glm::mat4> &meshTransforms,
+                     std::vector<unsigned int> &meshLights, std::vector<ImpostorInstance> &impostorInstances) {
+    meshTransforms.clear();
+    meshLights.clear();
+    impostorInstances.clear();
+    for (unsigned int i = 0; i < count; i++) {
+        const PacketDraw &draw = draws[i];
+        if (draw.occlusion != NO_OCCLUSION && occlusion.hidden(draw.occlusion)) {
+            continue;
+        }
+        float fade = 0.0f;
+        if (impostors) {
+            float distance = glm::length(draw.worldBounds.center() - viewPos);
+            fade = glm::clamp((distance - (impostorDistance - impostorFade)) / impostorFade, 0.0f, 1.0f);
+        }
+        if (fade < 1.0f) {
+            meshTransforms.push_back(draw.world);
+            meshLights.push_back(draw.lights);
+        }
+        if (fade > 0.0f) {
+            impostorInstances.push_back({draw.world, fade, draw.lights});
+        }
+    }
 }
 
+// GPU time of the scene pass in both modes since the last print. Toggling the pre-pass a few times
+// between two prints compares them on the same view: it pays off where many shaded pixels are overdrawn.
+void printScenePassTimes(const GpuTimer &prePass, const GpuTimer &withPrePass, const GpuTimer &withoutPrePass) {
+    std::ios::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(2) << "GPU scene pass:   ";
+    if (withPrePass.samples()) {
+        std::cout << prePass.milliseconds() + withPrePass.milliseconds() << " ms with depth pre-pass ("
+                  << prePass.milliseconds() << " ms of it depth only)";
+    } else {
+        std::cout << "no frames with depth pre-pass";
+    }
+    if (withoutPrePass.samples()) {
+        std::cout << ", " << withoutPrePass.milliseconds() << " ms without";
+    } else {
+        std::cout << ", no frames without";
+    }
+    std::cout << " (Z toggles)" << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
 
-void set_spot_light(Shader &objectShader, Camera &camera) {
-    objectShader.setVec3("spotLight.position", camera.Position);
-    objectShader.setVec3("spotLight.direction", camera.Front);
+void set_spot_light(SpotLightBlock &spotLight, Camera &camera) {
+    spotLight.position = camera.Position;
+    spotLight.direction = camera.Front;
     if (isSpotlightActivated) {
-        objectShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        objectShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-        objectShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
+        spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+        spotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+        spotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
     } else { // All to 0.
-        objectShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        objectShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-        objectShader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
+        spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+        spotLight.diffuse = glm::vec3(0.0f, 0.0f, 0.0f);
+        spotLight.specular = glm::vec3(0.0f, 0.0f, 0.0f);
     }
-    objectShader.setFloat("spotLight.constant", 1.0f);
-    objectShader.setFloat("spotLight.linear", 0.01);
-    objectShader.setFloat("spotLight.quadratic", 0.001);
-    objectShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(2.5f)));
-    objectShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(22.0f)));
-
-    objectShader.setVec3("viewPos", camera.Position);
-    objectShader.setFloat("material.shininess", 128.0f);
+    spotLight.constant = 1.0f;
+    spotLight.linear = 0.01f;
+    spotLight.quadratic = 0.001f;
+    spotLight.cutOff = glm::cos(glm::radians(2.5f));
+    spotLight.outerCutOff = glm::cos(glm::radians(22.0f));
 }
 
-void set_point_light(Shader &Shader, glm::vec3 &point_light_position, int i, float point_light_linear,
+void set_point_light(PointLightBlock &pointLight, const glm::vec3 &point_light_position, float point_light_linear,
                      float point_light_quadratic) {
-    Shader.setVec3("pointLights[" + to_string(i) + "].position", point_light_position);
-    Shader.setVec3("pointLights[" + to_string(i) + "].ambient", 0.2f, 0.2f, 0.2f);
-    Shader.setVec3("pointLights[" + to_string(i) + "].diffuse", 0.8f, 0.8f, 0.8f);
-    Shader.setVec3("pointLights[" + to_string(i) + "].specular", 1.0f, 1.0f, 1.0f);
-    Shader.setFloat("pointLights[" + to_string(i) + "].constant", 1.0f);
-    Shader.setFloat("pointLights[" + to_string(i) + "].linear", point_light_linear);
-    Shader.setFloat("pointLights[" + to_string(i) + "].quadratic", point_light_quadratic);
+    pointLight.position = point_light_position;
+    pointLight.ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+    pointLight.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+    pointLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    pointLight.constant = 1.0f;
+    pointLight.linear = point_light_linear;
+    pointLight.quadratic = point_light_quadratic;
 }
 
 void processInput(GLFWwindow *window) {
@@ -627,8 +1145,10 @@ void processInput(GLFWwindow *window) {
         camera.ProcessKeyboard(RIGHT, deltaTime);
 }
 
+// runs on the main thread, which has no GL context: the render thread applies the size
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-    glViewport(0, 0, width, height);
+    windowWidth = width;
+    windowHeight = height;
 }
 
 void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
@@ -651,7 +1171,25 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     camera.ProcessMouseScroll(yoffset);
 }
 
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+        pickRequested = true;
+    }
+}
+
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod) {
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        printRenderStats = true;
+    }
+
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        gpuCulling = !gpuCulling;
+    }
+
+    if (key == GLFW_KEY_Z && action == GLFW_PRESS) {
+        depthPrePass = !depthPrePass;
+    }
+
     if (key == GLFW_KEY_L && action == GLFW_PRESS) {
         isSpotlightActivated = !isSpotlightActivated;
     }
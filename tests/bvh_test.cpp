@@ -0,0 +1,130 @@
+// BVH queries against a brute-force scan of the same random boxes: queryFrustum() has to return
+// exactly the items whose boxes aren't outside the frustum and raycast() the nearest box hit,
+// right after build() and again after refit() has moved half of the items.
+
+#include <rg/BVH.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+static unsigned int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static AABB randomBox(std::mt19937 &random) {
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.1f, 3.0f);
+    AABB box;
+    box.min = glm::vec3(position(random), position(random), position(random));
+    box.max = box.min + glm::vec3(size(random), size(random), size(random));
+    return box;
+}
+
+static glm::vec3 randomDirection(std::mt19937 &random) {
+    std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+    glm::vec3 direction;
+    do {
+        direction = glm::vec3(component(random), component(random), component(random));
+    } while (glm::length(direction) < 0.1f);
+    return direction;
+}
+
+// items are sparse ids, boxes[i] belongs to items[i]
+static void compare(const BVH &bvh, const std::vector<unsigned int> &items, const std::vector<AABB> &boxes,
+                    std::mt19937 &random, const std::string &when) {
+    std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> fov(20.0f, 90.0f);
+    for (unsigned int view = 0; view < 50; ++view) {
+        glm::vec3 eye(position(random), position(random), position(random));
+        glm::mat4 projection = glm::perspective(glm::radians(fov(random)), 16.0f / 9.0f, 0.1f, 80.0f);
+        Frustum frustum = Frustum::fromMatrix(projection * glm::lookAt(eye, eye + randomDirection(random),
+                                                                       glm::vec3(0.0f, 1.0f, 0.0f)));
+        std::vector<unsigned int> found;
+        bvh.queryFrustum(frustum, found);
+        std::vector<unsigned int> expected;
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            if (testFrustum(frustum, boxes[i]) != OUTSIDE_FRUSTUM) {
+                expected.push_back(items[i]);
+            }
+        }
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        check(found == expected, when + ": frustum query " + std::to_string(view) + " returns " +
+                                 std::to_string(found.size()) + " items, the scan " + std::to_string(expected.size()));
+    }
+
+    unsigned int hits = 0;
+    for (unsigned int ray = 0; ray < 500; ++ray) {
+        glm::vec3 origin(position(random), position(random), position(random));
+        glm::vec3 direction = randomDirection(random);
+        glm::vec3 inverseDirection = glm::vec3(1.0f) / direction;
+        bool expectedHit = false;
+        float expectedDistance = std::numeric_limits<float>::max();
+        for (const AABB &box : boxes) {
+            float distance;
+            if (box.intersectsRay(origin, inverseDirection, std::numeric_limits<float>::max(), distance)
+                && distance < expectedDistance) {
+                expectedDistance = distance;
+                expectedHit = true;
+            }
+        }
+        unsigned int item = ~0u;
+        float distance = 0.0f;
+        bool hit = bvh.raycast(origin, direction, item, distance);
+        check(hit == expectedHit, when + ": ray " + std::to_string(ray) + " hits as in the scan");
+        if (hit && expectedHit) {
+            ++hits;
+            // ties between boxes entered at the same distance may pick either, so the distance is compared
+            check(distance == expectedDistance, when + ": ray " + std::to_string(ray) + " finds the nearest box");
+            std::size_t index = std::find(items.begin(), items.end(), item) - items.begin();
+            float itemDistance;
+            check(index < items.size()
+                  && boxes[index].intersectsRay(origin, inverseDirection, std::numeric_limits<float>::max(), itemDistance)
+                  && itemDistance == distance, when + ": ray " + std::to_string(ray) + " reports the box it hit");
+        }
+    }
+    check(hits > 50, when + ": enough rays hit a box to test raycast");
+}
+
+int main() {
+    std::mt19937 random(7);
+    const unsigned int count = 2000;
+    std::vector<unsigned int> items(count);
+    std::vector<AABB> boxes(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        items[i] = 3 * i + 1;
+        boxes[i] = randomBox(random);
+    }
+    BVH bvh;
+    bvh.build(items, boxes);
+    check(bvh.nodeCount() == 2 * count - 1, "one leaf per item");
+    compare(bvh, items, boxes, random, "after build");
+
+    // half of the items move anywhere, which loosens the tree but must not change any answer
+    for (unsigned int i = 0; i < count; i += 2) {
+        boxes[i] = randomBox(random);
+        bvh.refit(items[i], boxes[i]);
+    }
+    compare(bvh, items, boxes, random, "after refit");
+
+    BVH single;
+    single.build({5}, {boxes[0]});
+    std::vector<unsigned int> found;
+    glm::vec3 center = boxes[0].center();
+    single.queryFrustum(Frustum::fromMatrix(glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f)
+                                            * glm::lookAt(center + glm::vec3(0.0f, 0.0f, 10.0f), center,
+                                                          glm::vec3(0.0f, 1.0f, 0.0f))), found);
+    check(found.size() == 1 && found[0] == 5, "a one-item tree finds its item");
+
+    return failures == 0 ? 0 : 1;
+}
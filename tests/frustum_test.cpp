@@ -0,0 +1,92 @@
+// FrustumCuller without a GL context: spheres with a known answer, then every kernel the test
+// was compiled with against the scalar loop on random spheres, many of them touching a plane.
+
+#include <rg/Frustum.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static unsigned int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static const char *kernelName(CullKernel kernel) {
+    switch (kernel) {
+        case CullKernel::AVX:
+            return "AVX";
+        case CullKernel::SSE:
+            return "SSE";
+        default:
+            return "scalar";
+    }
+}
+
+int main() {
+    // the camera main.cpp starts with
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.0f, 12.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::fromMatrix(projection * view);
+
+    std::vector<CullKernel> kernels = {CullKernel::Scalar};
+    if (FrustumCuller::widestKernel() != CullKernel::Scalar) {
+        kernels.push_back(CullKernel::SSE);
+    }
+    if (FrustumCuller::widestKernel() == CullKernel::AVX) {
+        kernels.push_back(CullKernel::AVX);
+    }
+
+    FrustumCuller known;
+    known.add(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f);    // straight ahead
+    known.add(glm::vec3(0.0f, 1.0f, 20.0f), 1.0f);   // behind the camera
+    known.add(glm::vec3(0.0f, 1.0f, -200.0f), 1.0f); // past the far plane
+    known.add(glm::vec3(50.0f, 1.0f, 0.0f), 1.0f);   // off to the right
+    known.add(glm::vec3(0.0f, 1.0f, 13.0f), 2.0f);   // around the camera, reaching past the near plane
+    const std::vector<uint8_t> expected = {1, 0, 0, 0, 1};
+    for (CullKernel kernel : kernels) {
+        known.cull(frustum, kernel);
+        check(known.visible() == expected, std::string(kernelName(kernel)) + " kernel on spheres with a known answer");
+        check(known.visibleCount() == 2, std::string(kernelName(kernel)) + " kernel visible count");
+    }
+
+    // not a multiple of 8, so the kernels' last group is partly padding
+    const unsigned int count = 100003;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> size(0.05f, 3.0f);
+    std::uniform_int_distribution<int> plane(0, 5);
+    FrustumCuller culler;
+    culler.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        glm::vec3 center(position(random), position(random), position(random));
+        float radius = size(random);
+        if (i % 4 == 0) {
+            // exactly as far from the plane as the radius reaches, as rounded by the kernels
+            const glm::vec4 &p = frustum.planes[plane(random)];
+            radius = std::abs((center.x * p.x + center.y * p.y) + (center.z * p.z + p.w));
+        }
+        culler.add(center, radius);
+    }
+    culler.cull(frustum, CullKernel::Scalar);
+    std::vector<uint8_t> scalar = culler.visible();
+    check(culler.visibleCount() > 0 && culler.culledCount() > 0, "random spheres both visible and culled");
+    for (CullKernel kernel : kernels) {
+        culler.cull(frustum, kernel);
+        std::size_t differing = 0;
+        for (unsigned int i = 0; i < count; ++i) {
+            differing += culler.visible()[i] != scalar[i];
+        }
+        std::cout << kernelName(kernel) << ": " << culler.visibleCount() << " of " << count << " visible, "
+                  << differing << " differ from the scalar loop" << std::endl;
+        check(differing == 0, std::string(kernelName(kernel)) + " kernel agrees with the scalar loop");
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+// ResourcePool without a GL context: released handles go stale and resolve to 0, their slots are
+// reused under a new generation, generations wrap around without reaching 0, and a full pool
+// hands out null handles instead of aliasing slot 0.
+
+#include <rg/Resources.h>
+
+#include <iostream>
+#include <string>
+
+static unsigned int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+int main() {
+    {
+        ResourcePool<TextureInfo> pool;
+        TextureHandle first = pool.add(11);
+        TextureHandle second = pool.add(12);
+        check(!first.isNull() && !second.isNull(), "added handles are not null");
+        check(first != second, "two objects get different handles");
+        check(pool.name(first) == 11 && pool.name(second) == 12, "handles resolve to their names");
+        check(pool.size() == 2, "two objects alive");
+        check(pool.name(TextureHandle()) == 0 && !pool.valid(TextureHandle()), "the null handle resolves to 0");
+
+        TextureHandle copy = first;
+        check(pool.release(first) == 11, "release returns the name to delete");
+        check(!pool.valid(first) && !pool.valid(copy), "release makes every copy stale");
+        check(pool.name(copy) == 0, "a stale handle resolves to 0");
+        check(pool.release(copy) == 0, "releasing a stale handle returns 0");
+        check(pool.size() == 1, "one object alive after the release");
+        check(pool.name(second) == 12, "other handles are untouched");
+
+        TextureHandle reused = pool.add(13);
+        check(reused.index() == first.index(), "the released slot is reused");
+        check(reused.generation() != first.generation(), "the reused slot has a new generation");
+        check(pool.name(reused) == 13 && pool.name(first) == 0, "the old handle doesn't reach the new name");
+        check(pool.size() == 2, "two objects alive after the reuse");
+    }
+
+    {
+        // every release bumps the generation, after the last one it starts over at 1
+        ResourcePool<TextureInfo> pool;
+        TextureHandle handle = pool.add(1);
+        check(handle.generation() == 1, "generations start at 1");
+        for (unsigned int cycle = 1; cycle < HANDLE_GENERATION_MASK; ++cycle) {
+            pool.release(handle);
+            handle = pool.add(1);
+        }
+        check(handle.generation() == HANDLE_GENERATION_MASK, "the generation reaches its largest value");
+        pool.release(handle);
+        handle = pool.add(2);
+        check(handle.generation() == 1, "the generation wraps around to 1");
+        check(!handle.isNull() && handle.index() == 0, "a wrapped handle of slot 0 is not null");
+        check(pool.name(handle) == 2, "a wrapped handle resolves");
+    }
+
+    {
+        // slot indices fill HANDLE_INDEX_BITS, one more would alias slot 0
+        ResourcePool<VertexArrayInfo> pool;
+        VertexArrayHandle last;
+        for (unsigned int i = 0; i <= HANDLE_INDEX_MASK; ++i) {
+            last = pool.add(i + 1);
+        }
+        check(last.index() == HANDLE_INDEX_MASK && pool.name(last) == HANDLE_INDEX_MASK + 1,
+              "the last index is usable");
+        VertexArrayHandle overflow = pool.add(7);
+        check(overflow.isNull(), "a full pool returns a null handle");
+        check(pool.name(VertexArrayHandle::make(0, 1)) == 1, "slot 0 keeps its name");
+        check(pool.size() == HANDLE_INDEX_MASK + 1, "a refused add doesn't grow the pool");
+        pool.release(last);
+        check(!pool.add(8).isNull(), "a released slot can be taken again");
+    }
+
+    return failures == 0 ? 0 : 1;
+}
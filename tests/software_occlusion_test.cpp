@@ -0,0 +1,73 @@
+// SoftwareOcclusion without a GL context: boxes around a rasterized wall are reported hidden or
+// visible as seen from the camera, and the depth buffer doesn't depend on the thread count.
+
+#include <rg/SoftwareOcclusion.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <string>
+
+static unsigned int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static AABB box(const glm::vec3 &min, const glm::vec3 &max) {
+    AABB box;
+    box.min = min;
+    box.max = max;
+    return box;
+}
+
+int main() {
+    // camera at z = 5 looking down -z at a 4 x 4 wall through the origin
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f)
+                               * glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    AABB wall = box(glm::vec3(-2.0f, -2.0f, 0.0f), glm::vec3(2.0f, 2.0f, 0.2f));
+    OccluderMesh wallMesh = OccluderMesh::box(wall);
+
+    SoftwareOcclusion single(256, 144, 0);
+    SoftwareOcclusion threaded(256, 144, 3);
+    for (SoftwareOcclusion *occlusion : {&single, &threaded}) {
+        occlusion->begin(viewProjection);
+        occlusion->addOccluder(wallMesh, glm::mat4(1.0f));
+        occlusion->rasterize();
+    }
+
+    unsigned int differing = 0;
+    for (int y = 0; y < single.height(); ++y) {
+        for (int x = 0; x < single.width(); ++x) {
+            differing += single.depth(x, y) != threaded.depth(x, y);
+        }
+    }
+    check(differing == 0, "threaded and single-threaded depth buffers are identical");
+
+    for (SoftwareOcclusion *occlusion : {&single, &threaded}) {
+        std::string threads = occlusion == &single ? " (single-threaded)" : " (threaded)";
+        check(!occlusion->visible(box(glm::vec3(-0.5f, -0.5f, -3.0f), glm::vec3(0.5f, 0.5f, -2.0f))),
+              "box behind the wall is hidden" + threads);
+        check(occlusion->visible(box(glm::vec3(-0.5f, -0.5f, 1.0f), glm::vec3(0.5f, 0.5f, 2.0f))),
+              "box in front of the wall is visible" + threads);
+        check(occlusion->visible(box(glm::vec3(3.0f, -0.5f, -3.0f), glm::vec3(4.0f, 0.5f, -2.0f))),
+              "box behind and beside the wall is visible" + threads);
+        check(occlusion->visible(box(glm::vec3(1.5f, -0.5f, -3.0f), glm::vec3(3.5f, 0.5f, -2.0f))),
+              "box peeking out from behind the wall's edge is visible" + threads);
+        check(occlusion->visible(wall), "the occluder itself is visible" + threads);
+    }
+
+    // a wall crossing the near plane is clipped, not dropped
+    glm::mat4 close = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f)
+                      * glm::lookAt(glm::vec3(0.0f, 0.0f, 0.25f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    single.begin(close);
+    single.addOccluder(wallMesh, glm::mat4(1.0f));
+    single.rasterize();
+    check(!single.visible(box(glm::vec3(-0.5f, -0.5f, -3.0f), glm::vec3(0.5f, 0.5f, -2.0f))),
+          "box behind a wall crossing the near plane is hidden");
+
+    std::cout << single.stats() << std::endl;
+    return failures == 0 ? 0 : 1;
+}